@@ -0,0 +1,100 @@
+/** @file bucket.c
+ *  @brief A token bucket rate limiter
+ *
+ *  This contains the token bucket the receiver uses to hold its writes
+ *  to writeRate, and the sender uses for its rate limit. Tokens are
+ *  added in proportion to the time since the last refill, so refilling
+ *  as often as the caller likes never adds more than the rate allows.
+ *
+ *  @author Vicky Chen (chen-vv)
+ *  @author Eric Omielan (eomielan)
+ *  @bug No known bugs.
+ */
+
+/* -- Includes -- */
+
+#include "include/bucket.h"
+
+void bucket_init(struct TokenBucket *bucket, unsigned long long rate, long long capacity, unsigned long long now)
+{
+    bucket->rate = rate;
+    bucket->capacity = capacity;
+    bucket->tokens = capacity;
+    bucket->lastRefill = now;
+}
+
+void bucket_refill(struct TokenBucket *bucket, unsigned long long now)
+{
+    if (bucket->rate == 0 || now <= bucket->lastRefill)
+    {
+        return;
+    }
+
+    // Whole seconds and the rest are scaled separately, so a long idle period cannot overflow
+    unsigned long long elapsed = now - bucket->lastRefill;
+    unsigned long long added = elapsed / 1000000000ULL * bucket->rate +
+                               elapsed % 1000000000ULL * bucket->rate / 1000000000ULL;
+    if (added == 0)
+    {
+        return;
+    }
+
+    if (added >= (unsigned long long)(bucket->capacity - bucket->tokens))
+    {
+        bucket->tokens = bucket->capacity;
+        bucket->lastRefill = now;
+        return;
+    }
+
+    // Only the time the added tokens account for is used up, so fractions of a token are not lost
+    bucket->tokens += added;
+    bucket->lastRefill += added * 1000000000ULL / bucket->rate;
+}
+
+void bucket_set_rate(struct TokenBucket *bucket, unsigned long long rate, long long capacity, unsigned long long now)
+{
+    bucket_refill(bucket, now);
+
+    if (bucket->rate == 0)
+    {
+        bucket->tokens = capacity;
+        bucket->lastRefill = now;
+    }
+
+    bucket->rate = rate;
+    bucket->capacity = capacity;
+    if (bucket->tokens > capacity)
+    {
+        bucket->tokens = capacity;
+    }
+}
+
+void bucket_consume(struct TokenBucket *bucket, unsigned int bytes)
+{
+    if (bucket->rate == 0)
+    {
+        return;
+    }
+
+    bucket->tokens -= bytes;
+}
+
+unsigned long long bucket_delay(struct TokenBucket *bucket, unsigned long long now)
+{
+    if (bucket->rate == 0)
+    {
+        return 0;
+    }
+
+    bucket_refill(bucket, now);
+    if (bucket->tokens > 0)
+    {
+        return 0;
+    }
+
+    // The debt, and the token after it, are paid off from the last refill onwards
+    unsigned long long needed = 1 - bucket->tokens;
+    unsigned long long deadline = bucket->lastRefill + (needed * 1000000000ULL + bucket->rate - 1) / bucket->rate;
+
+    return deadline > now ? deadline - now : 0;
+}
@@ -0,0 +1,1050 @@
+/** @file congestion.c
+ *  @brief Congestion control for the UDP sender
+ *
+ *  This contains the loss recovery logic shared by every congestion
+ *  control algorithm, and the algorithms themselves. The sender calls
+ *  congestion_on_ack, congestion_on_loss and congestion_on_timeout, which
+ *  update the congestion window through the algorithm's CongestionOps.
+ *
+ *  @author Vicky Chen (chen-vv)
+ *  @author Eric Omielan (eomielan)
+ *  @bug No known bugs.
+ */
+
+/* -- Includes -- */
+
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "include/congestion.h"
+#include "include/udp.h"
+
+/* -- NewReno -- */
+
+/**
+ * @brief Initializes NewReno.
+ *
+ * NewReno keeps no state beyond the generic congestion control state.
+ *
+ * @param cc The congestion control state
+ * @return Void
+ */
+void newreno_init(struct CongestionControl *cc)
+{
+    (void)cc;
+}
+
+/**
+ * @brief Returns the NewReno slow start threshold after a loss.
+ *
+ * The window is halved, as in RFC 5681.
+ *
+ * @param cc The congestion control state
+ * @return The new slow start threshold, in packets
+ */
+unsigned int newreno_ssthresh(struct CongestionControl *cc)
+{
+    return cc->cwnd / 2 > MIN_SSTHRESH ? cc->cwnd / 2 : MIN_SSTHRESH;
+}
+
+/**
+ * @brief Grows the NewReno congestion window on an ACK.
+ *
+ * Below the slow start threshold the window grows by one packet per packet
+ * acknowledged (doubling every round trip). Above it, the window grows by one
+ * packet per window of packets acknowledged (one packet every round trip).
+ *
+ * @param cc The congestion control state
+ * @param ack The ACK
+ * @return Void
+ */
+void newreno_cong_avoid(struct CongestionControl *cc, const struct AckEvent *ack)
+{
+    unsigned int acked = ack->ackedPackets;
+
+    if (cc->cwnd < cc->ssthresh)
+    {
+        acked = congestion_slow_start(cc, acked);
+        if (acked == 0)
+        {
+            return;
+        }
+    }
+
+    congestion_avoidance(cc, cc->cwnd, acked);
+}
+
+/**
+ * @brief The NewReno congestion control algorithm.
+ */
+const struct CongestionOps _newreno = {
+    .name = "newreno",
+    .init = newreno_init,
+    .ssthresh = newreno_ssthresh,
+    .congAvoid = newreno_cong_avoid,
+    .onTimeout = NULL,
+    .congControl = NULL,
+};
+
+/* -- CUBIC -- */
+
+/**
+ * @brief CUBIC scaling constant C, in packets per second cubed (RFC 9438).
+ */
+#define CUBIC_C 0.4
+
+/**
+ * @brief CUBIC multiplicative decrease factor (beta).
+ */
+#define CUBIC_BETA 0.7
+
+/**
+ * @brief Smallest window, in packets, at which HyStart may end slow start.
+ */
+#define HYSTART_LOW_WINDOW 16
+
+/**
+ * @brief Number of round-trip time samples HyStart takes at the start of each round.
+ */
+#define HYSTART_MIN_SAMPLES 8
+
+/**
+ * @brief Longest gap between ACKs of one ACK train, in microseconds.
+ */
+#define HYSTART_ACK_DELTA 2000
+
+/**
+ * @brief Smallest round-trip time increase that ends slow start, in microseconds.
+ */
+#define HYSTART_DELAY_MIN 4000
+
+/**
+ * @brief Largest round-trip time increase needed to end slow start, in microseconds.
+ */
+#define HYSTART_DELAY_MAX 16000
+
+/**
+ * @brief Initializes CUBIC.
+ *
+ * @param cc The congestion control state
+ * @return Void
+ */
+void cubic_init(struct CongestionControl *cc)
+{
+    memset(&cc->algorithm.cubic, 0, sizeof(cc->algorithm.cubic));
+}
+
+/**
+ * @brief Starts a new HyStart round.
+ *
+ * A round lasts until every packet sent so far has been acknowledged.
+ *
+ * @param cubic The CUBIC state
+ * @param ack The ACK that started the round
+ * @return Void
+ */
+void hystart_reset(struct CubicState *cubic, const struct AckEvent *ack)
+{
+    cubic->roundStart = ack->now;
+    cubic->lastAck = ack->now;
+    cubic->roundEnd = ack->nextSequenceNumber;
+    cubic->roundMinRtt = 0;
+    cubic->rttSamples = 0;
+}
+
+/**
+ * @brief Checks whether slow start should end before the first loss (HyStart).
+ *
+ * Slow start ends once either the ACKs of a round arrive as a closely spaced
+ * train lasting half of the minimum round-trip time (the window has reached
+ * the path's capacity), or the round-trip time at the start of a round has
+ * grown noticeably above the minimum (a queue is building). This avoids the
+ * large burst of losses that ends slow start otherwise.
+ *
+ * @param cc The congestion control state
+ * @param ack The ACK
+ * @return Void
+ */
+void hystart_update(struct CongestionControl *cc, const struct AckEvent *ack)
+{
+    struct CubicState *cubic = &cc->algorithm.cubic;
+
+    if (!SEQ_LT(ack->cumulativeAck, cubic->roundEnd))
+    {
+        hystart_reset(cubic, ack);
+    }
+
+    if (cubic->hystartFound || cc->cwnd < HYSTART_LOW_WINDOW || cubic->minRtt == 0)
+    {
+        return;
+    }
+
+    // ACK train detection
+    if (ack->now - cubic->lastAck <= HYSTART_ACK_DELTA)
+    {
+        cubic->lastAck = ack->now;
+        if (ack->now - cubic->roundStart > cubic->minRtt / 2)
+        {
+            cubic->hystartFound = TRUE;
+        }
+    }
+
+    // Delay increase detection
+    if (ack->rtt > 0 && cubic->rttSamples < HYSTART_MIN_SAMPLES)
+    {
+        if (cubic->roundMinRtt == 0 || ack->rtt < cubic->roundMinRtt)
+        {
+            cubic->roundMinRtt = ack->rtt;
+        }
+
+        if (++cubic->rttSamples == HYSTART_MIN_SAMPLES)
+        {
+            unsigned long long threshold = cubic->minRtt / 8;
+            if (threshold < HYSTART_DELAY_MIN)
+            {
+                threshold = HYSTART_DELAY_MIN;
+            }
+            if (threshold > HYSTART_DELAY_MAX)
+            {
+                threshold = HYSTART_DELAY_MAX;
+            }
+
+            if (cubic->roundMinRtt > cubic->minRtt + threshold)
+            {
+                cubic->hystartFound = TRUE;
+            }
+        }
+    }
+
+    if (cubic->hystartFound)
+    {
+        cc->ssthresh = cc->cwnd;
+    }
+}
+
+/**
+ * @brief Computes how many packets must be acknowledged for each one-packet window increase.
+ *
+ * The window follows W(t) = C * (t - K)^3 + W_max, where t is the time since the
+ * last reduction and K is the time it takes to climb back to W_max. Far from W_max
+ * the window grows quickly; near W_max it plateaus, then probes beyond it. The
+ * window never grows slower than a Reno sender's would (TCP friendliness).
+ *
+ * @param cc The congestion control state
+ * @param ack The ACK
+ * @return The number of packets per one-packet increase
+ */
+unsigned int cubic_update(struct CongestionControl *cc, const struct AckEvent *ack)
+{
+    struct CubicState *cubic = &cc->algorithm.cubic;
+
+    if (cubic->epochStart == 0)
+    {
+        cubic->epochStart = ack->now;
+        cubic->ackCount = ack->ackedPackets;
+        cubic->renoCwnd = cc->cwnd;
+
+        if (cubic->lastMaxCwnd <= cc->cwnd)
+        {
+            cubic->k = 0;
+            cubic->originPoint = cc->cwnd;
+        }
+        else
+        {
+            cubic->k = cbrt((cubic->lastMaxCwnd - cc->cwnd) / CUBIC_C);
+            cubic->originPoint = cubic->lastMaxCwnd;
+        }
+    }
+    else
+    {
+        cubic->ackCount += ack->ackedPackets;
+    }
+
+    // Aim for the window one round trip from now
+    double t = (ack->now + cubic->minRtt - cubic->epochStart) / 1e6;
+    double target = cubic->originPoint + CUBIC_C * pow(t - cubic->k, 3);
+
+    unsigned int count;
+    if (target > cc->cwnd)
+    {
+        count = cc->cwnd / (target - cc->cwnd);
+    }
+    else
+    {
+        count = 100 * cc->cwnd;
+    }
+
+    // Do not grow too fast before the first loss
+    if (cubic->lastMaxCwnd == 0 && count > 20)
+    {
+        count = 20;
+    }
+
+    // A Reno sender with the same beta grows by 3 * (1 - beta) / (1 + beta) packets per round trip
+    unsigned int delta = cc->cwnd * (1 + CUBIC_BETA) / (3 * (1 - CUBIC_BETA));
+    if (delta < 1)
+    {
+        delta = 1;
+    }
+    while (cubic->ackCount > delta)
+    {
+        cubic->ackCount -= delta;
+        cubic->renoCwnd++;
+    }
+
+    if (cubic->renoCwnd > cc->cwnd)
+    {
+        unsigned int renoCount = cc->cwnd / (cubic->renoCwnd - cc->cwnd);
+        if (renoCount < count)
+        {
+            count = renoCount;
+        }
+    }
+
+    return count > 2 ? count : 2;
+}
+
+/**
+ * @brief Returns the CUBIC slow start threshold after a loss.
+ *
+ * The window is reduced to beta times its size. If the window was reduced
+ * before reaching the previous W_max, another flow probably joined the
+ * bottleneck, so W_max is lowered further to release bandwidth faster (fast
+ * convergence).
+ *
+ * @param cc The congestion control state
+ * @return The new slow start threshold, in packets
+ */
+unsigned int cubic_ssthresh(struct CongestionControl *cc)
+{
+    struct CubicState *cubic = &cc->algorithm.cubic;
+
+    cubic->epochStart = 0;
+
+    if (cc->cwnd < cubic->lastMaxCwnd)
+    {
+        cubic->lastMaxCwnd = cc->cwnd * (1 + CUBIC_BETA) / 2;
+    }
+    else
+    {
+        cubic->lastMaxCwnd = cc->cwnd;
+    }
+
+    unsigned int ssthresh = cc->cwnd * CUBIC_BETA;
+    return ssthresh > MIN_SSTHRESH ? ssthresh : MIN_SSTHRESH;
+}
+
+/**
+ * @brief Grows the CUBIC congestion window on an ACK.
+ *
+ * Uses slow start (ended early by HyStart) below the slow start threshold,
+ * and the cubic window function above it.
+ *
+ * @param cc The congestion control state
+ * @param ack The ACK
+ * @return Void
+ */
+void cubic_cong_avoid(struct CongestionControl *cc, const struct AckEvent *ack)
+{
+    struct CubicState *cubic = &cc->algorithm.cubic;
+    unsigned int acked = ack->ackedPackets;
+
+    if (ack->rtt > 0 && (cubic->minRtt == 0 || ack->rtt < cubic->minRtt))
+    {
+        cubic->minRtt = ack->rtt;
+    }
+
+    if (cc->cwnd < cc->ssthresh)
+    {
+        hystart_update(cc, ack);
+
+        acked = congestion_slow_start(cc, acked);
+        if (acked == 0)
+        {
+            return;
+        }
+    }
+
+    congestion_avoidance(cc, cubic_update(cc, ack), acked);
+}
+
+/**
+ * @brief Restarts CUBIC after a retransmission timeout.
+ *
+ * The window starts over from slow start, so the cubic epoch and HyStart are reset.
+ *
+ * @param cc The congestion control state
+ * @return Void
+ */
+void cubic_on_timeout(struct CongestionControl *cc)
+{
+    struct CubicState *cubic = &cc->algorithm.cubic;
+
+    cubic->epochStart = 0;
+    cubic->hystartFound = FALSE;
+}
+
+/**
+ * @brief The CUBIC congestion control algorithm.
+ */
+const struct CongestionOps _cubic = {
+    .name = "cubic",
+    .init = cubic_init,
+    .ssthresh = cubic_ssthresh,
+    .congAvoid = cubic_cong_avoid,
+    .onTimeout = cubic_on_timeout,
+    .congControl = NULL,
+};
+
+/* -- BBR -- */
+
+/**
+ * @brief Size of a full data packet on the wire, used to turn bytes into packets.
+ */
+#define BBR_PACKET_SIZE MAX_PACKET_SIZE
+
+/**
+ * @brief Gain used in startup, 2/ln(2), the smallest that doubles the delivery rate every round trip.
+ */
+#define BBR_HIGH_GAIN 2.885
+
+/**
+ * @brief Window gain in PROBE_BW, leaving room for delayed and aggregated ACKs.
+ */
+#define BBR_CWND_GAIN 2.0
+
+/**
+ * @brief Fraction of the model's rate actually paced at, to keep queues short.
+ */
+#define BBR_PACING_MARGIN 0.99
+
+/**
+ * @brief Number of phases in the PROBE_BW gain cycle.
+ */
+#define BBR_CYCLE_LENGTH 8
+
+/**
+ * @brief How long a minimum round-trip time measurement stays valid, in microseconds.
+ */
+#define BBR_MIN_RTT_WINDOW 10000000ULL
+
+/**
+ * @brief Shortest time spent in PROBE_RTT, in microseconds.
+ */
+#define BBR_PROBE_RTT_TIME 200000ULL
+
+/**
+ * @brief Smallest congestion window BBR uses, in packets.
+ */
+#define BBR_MIN_CWND 4
+
+/**
+ * @brief Growth in bandwidth per round that startup still considers significant.
+ */
+#define BBR_FULL_BW_GROWTH 1.25
+
+/**
+ * @brief Rounds without significant growth after which startup ends.
+ */
+#define BBR_FULL_BW_ROUNDS 3
+
+/**
+ * @brief Round-trip time assumed before the first sample, in microseconds.
+ */
+#define BBR_DEFAULT_RTT 1000
+
+/**
+ * @brief Pacing gains of the PROBE_BW phases: probe for more bandwidth, drain the resulting queue, then cruise.
+ */
+const double _bbrPacingGains[BBR_CYCLE_LENGTH] = {1.25, 0.75, 1, 1, 1, 1, 1, 1};
+
+/**
+ * @brief Returns the estimated bottleneck bandwidth.
+ *
+ * This is the largest delivery rate seen over the last BBR_BW_ROUNDS rounds.
+ *
+ * @param bbr The BBR state
+ * @return The bandwidth, in bytes per second
+ */
+unsigned long long bbr_bandwidth(const struct BbrState *bbr)
+{
+    unsigned long long bw = 0;
+
+    for (int i = 0; i < BBR_BW_ROUNDS; i++)
+    {
+        if (bbr->bwSamples[i] > bw)
+        {
+            bw = bbr->bwSamples[i];
+        }
+    }
+
+    return bw;
+}
+
+/**
+ * @brief Returns a multiple of the estimated bandwidth-delay product.
+ *
+ * @param bbr The BBR state
+ * @param gain The multiple
+ * @return The window, in packets
+ */
+unsigned int bbr_bdp(const struct BbrState *bbr, double gain)
+{
+    unsigned long long bw = bbr_bandwidth(bbr);
+
+    // Without a model yet, stay at the initial window
+    if (bbr->minRtt == 0 || bw == 0)
+    {
+        return INITIAL_CWND;
+    }
+
+    double bdp = (double)bw * bbr->minRtt / 1e6;
+    return (unsigned int)ceil(bdp * gain / BBR_PACKET_SIZE);
+}
+
+/**
+ * @brief Sets the pacing rate to the estimated bandwidth times the pacing gain.
+ *
+ * Until startup has found the bottleneck, the rate is never lowered.
+ *
+ * @param cc The congestion control state
+ * @return Void
+ */
+void bbr_set_pacing_rate(struct CongestionControl *cc)
+{
+    struct BbrState *bbr = &cc->algorithm.bbr;
+    unsigned long long bw = bbr_bandwidth(bbr);
+
+    if (bw == 0)
+    {
+        return;
+    }
+
+    unsigned long long rate = bw * bbr->pacingGain * BBR_PACING_MARGIN;
+    if (bbr->fullBwReached || rate > cc->pacingRate)
+    {
+        cc->pacingRate = rate;
+    }
+}
+
+/**
+ * @brief Initializes BBR.
+ *
+ * BBR starts in startup, paced at the initial window per assumed round trip.
+ *
+ * @param cc The congestion control state
+ * @return Void
+ */
+void bbr_init(struct CongestionControl *cc)
+{
+    struct BbrState *bbr = &cc->algorithm.bbr;
+
+    memset(bbr, 0, sizeof(*bbr));
+    bbr->mode = BBR_STARTUP;
+    bbr->pacingGain = BBR_HIGH_GAIN;
+    bbr->cwndGain = BBR_HIGH_GAIN;
+    bbr->previousState = RECOVERY_OPEN;
+
+    cc->pacingRate = BBR_HIGH_GAIN * cc->cwnd * BBR_PACKET_SIZE * 1000000ULL / BBR_DEFAULT_RTT;
+}
+
+/**
+ * @brief Saves the window before loss recovery, so it can be restored afterwards.
+ *
+ * BBR does not reduce its window on a loss, so the threshold is the current window.
+ *
+ * @param cc The congestion control state
+ * @return The current window, in packets
+ */
+unsigned int bbr_ssthresh(struct CongestionControl *cc)
+{
+    struct BbrState *bbr = &cc->algorithm.bbr;
+
+    if (cc->state == RECOVERY_OPEN && bbr->mode != BBR_PROBE_RTT)
+    {
+        bbr->priorCwnd = cc->cwnd;
+    }
+    else if (cc->cwnd > bbr->priorCwnd)
+    {
+        bbr->priorCwnd = cc->cwnd;
+    }
+
+    return cc->cwnd;
+}
+
+/**
+ * @brief Updates the bandwidth estimate from the ACK's delivery rate sample.
+ *
+ * Also tracks round trips: a round ends once a packet sent after the start of
+ * the round is acknowledged.
+ *
+ * @param cc The congestion control state
+ * @param ack The ACK
+ * @return Void
+ */
+void bbr_update_bandwidth(struct CongestionControl *cc, const struct AckEvent *ack)
+{
+    struct BbrState *bbr = &cc->algorithm.bbr;
+
+    bbr->roundStart = FALSE;
+    if (ack->rate.interval == 0 || ack->rate.delivered == 0)
+    {
+        return;
+    }
+
+    if (ack->rate.priorDelivered >= bbr->nextRoundDelivered)
+    {
+        bbr->nextRoundDelivered = ack->delivered;
+        bbr->roundCount++;
+        bbr->roundStart = TRUE;
+        bbr->packetConservation = FALSE;
+        bbr->bwSamples[bbr->roundCount % BBR_BW_ROUNDS] = 0;
+    }
+
+    // An application-limited sample only counts if it shows more bandwidth than the estimate
+    unsigned long long bw = ack->rate.delivered * 1000000ULL / ack->rate.interval;
+    if (!ack->rate.appLimited || bw >= bbr_bandwidth(bbr))
+    {
+        unsigned long long *sample = &bbr->bwSamples[bbr->roundCount % BBR_BW_ROUNDS];
+        if (bw > *sample)
+        {
+            *sample = bw;
+        }
+    }
+}
+
+/**
+ * @brief Moves to the next phase of the PROBE_BW gain cycle when the current one is done.
+ *
+ * Each phase lasts at least the minimum round-trip time. The probing phase
+ * also continues until the extra data is actually in flight (or losses show
+ * there is no room for it), and the draining phase ends early once the queue
+ * is gone.
+ *
+ * @param cc The congestion control state
+ * @param ack The ACK
+ * @return Void
+ */
+void bbr_update_cycle_phase(struct CongestionControl *cc, const struct AckEvent *ack)
+{
+    struct BbrState *bbr = &cc->algorithm.bbr;
+
+    if (bbr->mode != BBR_PROBE_BW)
+    {
+        return;
+    }
+
+    int fullLength = ack->now - bbr->cycleStamp > bbr->minRtt;
+    int nextPhase;
+
+    if (bbr->pacingGain > 1)
+    {
+        nextPhase = fullLength && (ack->lostPackets > 0 || ack->packetsInFlight >= bbr_bdp(bbr, bbr->pacingGain));
+    }
+    else if (bbr->pacingGain < 1)
+    {
+        nextPhase = fullLength || ack->packetsInFlight <= bbr_bdp(bbr, 1);
+    }
+    else
+    {
+        nextPhase = fullLength;
+    }
+
+    if (nextPhase)
+    {
+        bbr->cycleIndex = (bbr->cycleIndex + 1) % BBR_CYCLE_LENGTH;
+        bbr->cycleStamp = ack->now;
+        bbr->pacingGain = _bbrPacingGains[bbr->cycleIndex];
+    }
+}
+
+/**
+ * @brief Enters PROBE_BW at a random phase other than the draining one.
+ *
+ * @param bbr The BBR state
+ * @param now The current time, in microseconds
+ * @return Void
+ */
+void bbr_enter_probe_bw(struct BbrState *bbr, unsigned long long now)
+{
+    bbr->mode = BBR_PROBE_BW;
+    bbr->cwndGain = BBR_CWND_GAIN;
+    bbr->cycleIndex = rand() % (BBR_CYCLE_LENGTH - 1);
+    if (bbr->cycleIndex >= 1)
+    {
+        bbr->cycleIndex++;
+    }
+    bbr->cycleStamp = now;
+    bbr->pacingGain = _bbrPacingGains[bbr->cycleIndex];
+}
+
+/**
+ * @brief Ends startup once the bandwidth has stopped growing, then drains the queue it built.
+ *
+ * @param cc The congestion control state
+ * @param ack The ACK
+ * @return Void
+ */
+void bbr_check_startup_done(struct CongestionControl *cc, const struct AckEvent *ack)
+{
+    struct BbrState *bbr = &cc->algorithm.bbr;
+
+    if (!bbr->fullBwReached && bbr->roundStart && !ack->rate.appLimited)
+    {
+        unsigned long long bw = bbr_bandwidth(bbr);
+        if (bw >= bbr->fullBw * BBR_FULL_BW_GROWTH)
+        {
+            bbr->fullBw = bw;
+            bbr->fullBwCount = 0;
+        }
+        else if (++bbr->fullBwCount >= BBR_FULL_BW_ROUNDS)
+        {
+            bbr->fullBwReached = TRUE;
+        }
+    }
+
+    if (bbr->mode == BBR_STARTUP && bbr->fullBwReached)
+    {
+        bbr->mode = BBR_DRAIN;
+        bbr->pacingGain = 1 / BBR_HIGH_GAIN;
+        bbr->cwndGain = BBR_HIGH_GAIN;
+    }
+
+    if (bbr->mode == BBR_DRAIN && ack->packetsInFlight <= bbr_bdp(bbr, 1))
+    {
+        bbr_enter_probe_bw(bbr, ack->now);
+    }
+}
+
+/**
+ * @brief Updates the minimum round-trip time, and measures it afresh when it is too old.
+ *
+ * If the minimum has not been seen for BBR_MIN_RTT_WINDOW, BBR enters PROBE_RTT:
+ * it shrinks the window to BBR_MIN_CWND packets for at least a round trip and
+ * BBR_PROBE_RTT_TIME, so that any queue drains and the true minimum can be seen.
+ *
+ * @param cc The congestion control state
+ * @param ack The ACK
+ * @return Void
+ */
+void bbr_update_min_rtt(struct CongestionControl *cc, const struct AckEvent *ack)
+{
+    struct BbrState *bbr = &cc->algorithm.bbr;
+    int expired = bbr->minRtt != 0 && ack->now > bbr->minRttStamp + BBR_MIN_RTT_WINDOW;
+
+    if (ack->rtt > 0 && (bbr->minRtt == 0 || ack->rtt < bbr->minRtt || expired))
+    {
+        bbr->minRtt = ack->rtt;
+        bbr->minRttStamp = ack->now;
+    }
+
+    if (expired && bbr->mode != BBR_PROBE_RTT)
+    {
+        bbr->mode = BBR_PROBE_RTT;
+        bbr->pacingGain = 1;
+        bbr->cwndGain = 1;
+        bbr->probeRttDoneStamp = 0;
+        if (cc->state == RECOVERY_OPEN)
+        {
+            bbr->priorCwnd = cc->cwnd;
+        }
+    }
+
+    if (bbr->mode != BBR_PROBE_RTT)
+    {
+        return;
+    }
+
+    if (bbr->probeRttDoneStamp == 0 && ack->packetsInFlight <= BBR_MIN_CWND)
+    {
+        bbr->probeRttDoneStamp = ack->now + BBR_PROBE_RTT_TIME;
+        bbr->probeRttRoundDone = FALSE;
+        bbr->nextRoundDelivered = ack->delivered;
+    }
+    else if (bbr->probeRttDoneStamp != 0)
+    {
+        if (bbr->roundStart)
+        {
+            bbr->probeRttRoundDone = TRUE;
+        }
+
+        if (bbr->probeRttRoundDone && ack->now > bbr->probeRttDoneStamp)
+        {
+            bbr->minRttStamp = ack->now;
+            if (cc->cwnd < bbr->priorCwnd)
+            {
+                cc->cwnd = bbr->priorCwnd;
+            }
+
+            if (bbr->fullBwReached)
+            {
+                bbr_enter_probe_bw(bbr, ack->now);
+            }
+            else
+            {
+                bbr->mode = BBR_STARTUP;
+                bbr->pacingGain = BBR_HIGH_GAIN;
+                bbr->cwndGain = BBR_HIGH_GAIN;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Applies packet conservation during loss recovery, and restores the window after it.
+ *
+ * In the first round of recovery, only as many packets are sent as are
+ * acknowledged. Once recovery ends, the window from before the loss comes back.
+ *
+ * @param cc The congestion control state
+ * @param ack The ACK
+ * @return TRUE if the window was set by packet conservation
+ */
+int bbr_recover_or_restore(struct CongestionControl *cc, const struct AckEvent *ack)
+{
+    struct BbrState *bbr = &cc->algorithm.bbr;
+    unsigned int cwnd = cc->cwnd;
+
+    if (ack->lostPackets > 0)
+    {
+        cwnd = cwnd > ack->lostPackets ? cwnd - ack->lostPackets : 1;
+    }
+
+    if (cc->state == RECOVERY_FAST && bbr->previousState != RECOVERY_FAST)
+    {
+        bbr->packetConservation = TRUE;
+        bbr->nextRoundDelivered = ack->delivered;
+        cwnd = ack->packetsInFlight + ack->ackedPackets;
+    }
+    else if (cc->state == RECOVERY_OPEN && bbr->previousState != RECOVERY_OPEN)
+    {
+        if (cwnd < bbr->priorCwnd)
+        {
+            cwnd = bbr->priorCwnd;
+        }
+        bbr->packetConservation = FALSE;
+    }
+    bbr->previousState = cc->state;
+
+    if (bbr->packetConservation && cwnd < ack->packetsInFlight + ack->ackedPackets)
+    {
+        cwnd = ack->packetsInFlight + ack->ackedPackets;
+    }
+
+    cc->cwnd = cwnd;
+    return bbr->packetConservation;
+}
+
+/**
+ * @brief Sets the BBR window and pacing rate on an ACK.
+ *
+ * BBR models the path by its bottleneck bandwidth (the largest recent delivery
+ * rate) and its minimum round-trip time. It paces at the bandwidth times a gain
+ * that depends on its mode, and keeps the window at a multiple of the
+ * bandwidth-delay product, rather than reacting to every loss.
+ *
+ * @param cc The congestion control state
+ * @param ack The ACK
+ * @return Void
+ */
+void bbr_cong_control(struct CongestionControl *cc, const struct AckEvent *ack)
+{
+    struct BbrState *bbr = &cc->algorithm.bbr;
+
+    bbr_update_bandwidth(cc, ack);
+    bbr_update_cycle_phase(cc, ack);
+    bbr_check_startup_done(cc, ack);
+    bbr_update_min_rtt(cc, ack);
+
+    bbr_set_pacing_rate(cc);
+
+    if (ack->ackedPackets > 0 && !bbr_recover_or_restore(cc, ack))
+    {
+        unsigned int target = bbr_bdp(bbr, bbr->cwndGain);
+
+        if (bbr->fullBwReached)
+        {
+            unsigned int cwnd = cc->cwnd + ack->ackedPackets;
+            cc->cwnd = cwnd < target ? cwnd : target;
+        }
+        else if (cc->cwnd < target || ack->delivered < INITIAL_CWND * BBR_PACKET_SIZE)
+        {
+            cc->cwnd += ack->ackedPackets;
+        }
+
+        if (cc->cwnd < BBR_MIN_CWND)
+        {
+            cc->cwnd = BBR_MIN_CWND;
+        }
+    }
+
+    if (bbr->mode == BBR_PROBE_RTT && cc->cwnd > BBR_MIN_CWND)
+    {
+        cc->cwnd = BBR_MIN_CWND;
+    }
+}
+
+/**
+ * @brief The BBR congestion control algorithm.
+ */
+const struct CongestionOps _bbr = {
+    .name = "bbr",
+    .init = bbr_init,
+    .ssthresh = bbr_ssthresh,
+    .congAvoid = NULL,
+    .onTimeout = NULL,
+    .congControl = bbr_cong_control,
+};
+
+/* -- Generic congestion control -- */
+
+/**
+ * @brief Every available congestion control algorithm, terminated by NULL.
+ */
+const struct CongestionOps *_congestionAlgorithms[] = {
+    &_newreno,
+    &_cubic,
+    &_bbr,
+    NULL,
+};
+
+const struct CongestionOps *congestion_find(const char *name)
+{
+    for (int i = 0; _congestionAlgorithms[i] != NULL; i++)
+    {
+        if (strcmp(_congestionAlgorithms[i]->name, name) == 0)
+        {
+            return _congestionAlgorithms[i];
+        }
+    }
+
+    return NULL;
+}
+
+void congestion_init(struct CongestionControl *cc, const struct CongestionOps *ops, unsigned int cwndClamp)
+{
+    memset(cc, 0, sizeof(*cc));
+
+    cc->ops = ops;
+    cc->cwndClamp = cwndClamp;
+    cc->cwnd = INITIAL_CWND < cwndClamp ? INITIAL_CWND : cwndClamp;
+    cc->ssthresh = UINT_MAX;
+    cc->state = RECOVERY_OPEN;
+
+    cc->ops->init(cc);
+}
+
+/**
+ * @brief Keeps the congestion window between one packet and the clamp.
+ *
+ * @param cc The congestion control state
+ * @return Void
+ */
+void congestion_clamp(struct CongestionControl *cc)
+{
+    if (cc->cwnd > cc->cwndClamp)
+    {
+        cc->cwnd = cc->cwndClamp;
+    }
+    if (cc->cwnd < 1)
+    {
+        cc->cwnd = 1;
+    }
+}
+
+void congestion_on_ack(struct CongestionControl *cc, const struct AckEvent *ack)
+{
+    // Recovery ends once everything that was in flight when the loss was detected is acknowledged
+    if (cc->state != RECOVERY_OPEN && !SEQ_LT(ack->cumulativeAck, cc->recoveryPoint))
+    {
+        if (cc->state == RECOVERY_FAST)
+        {
+            cc->cwnd = cc->ssthresh;
+            cc->cwndCount = 0;
+        }
+
+        cc->state = RECOVERY_OPEN;
+    }
+
+    if (cc->ops->congControl != NULL)
+    {
+        cc->ops->congControl(cc, ack);
+    }
+    // The window is held during fast recovery, but grows again from one packet after a timeout
+    else if (cc->state != RECOVERY_FAST && ack->ackedPackets > 0)
+    {
+        cc->ops->congAvoid(cc, ack);
+    }
+
+    congestion_clamp(cc);
+}
+
+void congestion_on_loss(struct CongestionControl *cc, uint32_t nextSequenceNumber)
+{
+    // Only reduce the window once per window of data
+    if (cc->state != RECOVERY_OPEN)
+    {
+        return;
+    }
+
+    cc->ssthresh = cc->ops->ssthresh(cc);
+    cc->cwnd = cc->ssthresh;
+    cc->cwndCount = 0;
+    cc->state = RECOVERY_FAST;
+    cc->recoveryPoint = nextSequenceNumber;
+
+    congestion_clamp(cc);
+}
+
+void congestion_on_timeout(struct CongestionControl *cc, uint32_t nextSequenceNumber)
+{
+    // If already recovering, the threshold was reduced for this window of data
+    if (cc->state == RECOVERY_OPEN)
+    {
+        cc->ssthresh = cc->ops->ssthresh(cc);
+    }
+
+    cc->cwnd = 1;
+    cc->cwndCount = 0;
+    cc->state = RECOVERY_TIMEOUT;
+    cc->recoveryPoint = nextSequenceNumber;
+
+    if (cc->ops->onTimeout != NULL)
+    {
+        cc->ops->onTimeout(cc);
+    }
+}
+
+unsigned int congestion_slow_start(struct CongestionControl *cc, unsigned int acked)
+{
+    unsigned int cwnd = cc->cwnd + acked;
+    if (cwnd > cc->ssthresh)
+    {
+        cwnd = cc->ssthresh;
+    }
+
+    acked -= cwnd - cc->cwnd;
+    cc->cwnd = cwnd;
+
+    return acked;
+}
+
+void congestion_avoidance(struct CongestionControl *cc, unsigned int w, unsigned int acked)
+{
+    // If the window changed since the count started, apply the increase right away
+    if (cc->cwndCount >= w)
+    {
+        cc->cwndCount = 0;
+        cc->cwnd++;
+    }
+
+    cc->cwndCount += acked;
+    if (cc->cwndCount >= w)
+    {
+        cc->cwnd += cc->cwndCount / w;
+        cc->cwndCount -= (cc->cwndCount / w) * w;
+    }
+}
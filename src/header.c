@@ -0,0 +1,113 @@
+/** @file header.c
+ *  @brief Wire format of data packet headers
+ *
+ *  This contains the code that writes and reads the packed, network
+ *  byte order header at the start of every data packet. See header.h
+ *  for the layout.
+ *
+ *  @author Vicky Chen (chen-vv)
+ *  @author Eric Omielan (eomielan)
+ *  @bug No known bugs.
+ */
+
+/* -- Includes -- */
+
+#include <string.h>
+#include <arpa/inet.h>
+#include <sys/types.h>
+
+#include "include/header.h"
+#include "include/udp.h"
+
+int header_encode(const struct Header *header, char *buffer)
+{
+    uint16_t messageLength = htons(header->messageLength);
+    uint32_t sequenceNumber = htonl(header->sequenceNumber);
+
+    buffer[0] = (PROTOCOL_VERSION << 4) | (header->lastPacket ? HEADER_FLAG_LAST_PACKET : 0);
+    buffer[1] = HEADER_SIZE;
+    memcpy(buffer + 2, &messageLength, sizeof(messageLength));
+    memcpy(buffer + 4, &sequenceNumber, sizeof(sequenceNumber));
+
+    return HEADER_SIZE;
+}
+
+int header_add_extension(char *buffer, uint8_t type, const void *value, uint8_t length)
+{
+    int headerLength = (uint8_t)buffer[1];
+    if (headerLength + EXTENSION_HEADER_SIZE + length > MAX_HEADER_SIZE)
+    {
+        return -1;
+    }
+
+    buffer[headerLength] = type;
+    buffer[headerLength + 1] = length;
+    memcpy(buffer + headerLength + EXTENSION_HEADER_SIZE, value, length);
+
+    headerLength += EXTENSION_HEADER_SIZE + length;
+    buffer[1] = headerLength;
+
+    return headerLength;
+}
+
+int header_decode(struct Header *header, const char *buffer, int length)
+{
+    if (length < HEADER_SIZE || ((uint8_t)buffer[0] >> 4) != PROTOCOL_VERSION)
+    {
+        return -1;
+    }
+
+    int headerLength = (uint8_t)buffer[1];
+    if (headerLength < HEADER_SIZE || headerLength > length)
+    {
+        return -1;
+    }
+
+    // Extensions must exactly fill the rest of the header
+    int offset = HEADER_SIZE;
+    while (offset < headerLength)
+    {
+        if (offset + EXTENSION_HEADER_SIZE > headerLength)
+        {
+            return -1;
+        }
+
+        offset += EXTENSION_HEADER_SIZE + (uint8_t)buffer[offset + 1];
+    }
+    if (offset != headerLength)
+    {
+        return -1;
+    }
+
+    uint16_t messageLength;
+    uint32_t sequenceNumber;
+    memcpy(&messageLength, buffer + 2, sizeof(messageLength));
+    memcpy(&sequenceNumber, buffer + 4, sizeof(sequenceNumber));
+
+    header->messageLength = ntohs(messageLength);
+    header->sequenceNumber = ntohl(sequenceNumber);
+    header->lastPacket = (buffer[0] & HEADER_FLAG_LAST_PACKET) != 0;
+
+    if (header->messageLength > MAX_BUFFER_SIZE || header->messageLength != length - headerLength)
+    {
+        return -1;
+    }
+
+    return headerLength;
+}
+
+const void *header_find_extension(const char *buffer, uint8_t type, uint8_t *length)
+{
+    int headerLength = (uint8_t)buffer[1];
+
+    for (int offset = HEADER_SIZE; offset < headerLength; offset += EXTENSION_HEADER_SIZE + (uint8_t)buffer[offset + 1])
+    {
+        if ((uint8_t)buffer[offset] == type)
+        {
+            *length = buffer[offset + 1];
+            return buffer + offset + EXTENSION_HEADER_SIZE;
+        }
+    }
+
+    return NULL;
+}
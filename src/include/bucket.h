@@ -0,0 +1,86 @@
+/** @file bucket.h
+ *  @brief Structure and function definitions for a token bucket
+ *         rate limiter.
+ *
+ *  Tokens (bytes) flow into the bucket at a fixed rate, up to its
+ *  capacity, and every byte handled takes one out. A bucket that runs
+ *  dry goes into debt rather than refusing bytes, so the caller decides
+ *  what to hold back; the debt is paid off as tokens flow back in. The
+ *  capacity bounds the burst allowed after an idle period. Times are in
+ *  nanoseconds, so the rate is enforced well below one second.
+ *
+ *  @author Vicky Chen (chen-vv)
+ *  @author Eric Omielan (eomielan)
+ *  @bug No known bugs.
+ */
+
+#ifndef BUCKET_H
+#define BUCKET_H
+
+/**
+ * @brief State of a token bucket.
+ */
+struct TokenBucket
+{
+    unsigned long long rate;         /**< Rate tokens flow in at, in bytes per second, or 0 for no limit. */
+    long long capacity;              /**< Largest number of tokens the bucket holds. */
+    long long tokens;                /**< Number of tokens in the bucket, negative while in debt. */
+    unsigned long long lastRefill;   /**< Time tokens were last added. */
+};
+
+/**
+ * @brief Initializes a token bucket, starting full.
+ *
+ * @param bucket The token bucket
+ * @param rate The rate, in bytes per second, or 0 for no limit
+ * @param capacity The largest number of tokens the bucket holds
+ * @param now The current time, in nanoseconds
+ * @return Void
+ */
+void bucket_init(struct TokenBucket *bucket, unsigned long long rate, long long capacity, unsigned long long now);
+
+/**
+ * @brief Adds the tokens that have flowed in since the last refill.
+ *
+ * @param bucket The token bucket
+ * @param now The current time, in nanoseconds
+ * @return Void
+ */
+void bucket_refill(struct TokenBucket *bucket, unsigned long long now);
+
+/**
+ * @brief Changes the rate and the capacity of a token bucket.
+ *
+ * Tokens that have flowed in so far are added at the old rate. A bucket that
+ * had no limit starts full, and one that holds more than the new capacity is
+ * emptied down to it.
+ *
+ * @param bucket The token bucket
+ * @param rate The rate, in bytes per second, or 0 for no limit
+ * @param capacity The largest number of tokens the bucket holds
+ * @param now The current time, in nanoseconds
+ * @return Void
+ */
+void bucket_set_rate(struct TokenBucket *bucket, unsigned long long rate, long long capacity, unsigned long long now);
+
+/**
+ * @brief Takes tokens out of the bucket for bytes that were handled, going into debt if needed.
+ *
+ * Nothing is taken out of a bucket with no limit.
+ *
+ * @param bucket The token bucket
+ * @param bytes The number of bytes
+ * @return Void
+ */
+void bucket_consume(struct TokenBucket *bucket, unsigned int bytes);
+
+/**
+ * @brief Returns how long to wait before the bucket holds tokens again.
+ *
+ * @param bucket The token bucket
+ * @param now The current time, in nanoseconds
+ * @return The time to wait, in nanoseconds, or 0 if the bucket holds tokens now
+ */
+unsigned long long bucket_delay(struct TokenBucket *bucket, unsigned long long now);
+
+#endif // BUCKET_H
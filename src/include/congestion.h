@@ -0,0 +1,256 @@
+/** @file congestion.h
+ *  @brief Structure and function definitions for the congestion
+ *         control used by the sender.
+ *
+ *  The sender keeps a congestion window (cwnd) that limits how many
+ *  packets may be in flight. The generic code in congestion.c handles
+ *  slow start thresholds and loss recovery, and calls into a
+ *  congestion control algorithm (struct CongestionOps) to decide how
+ *  the window grows and how much it shrinks after a loss.
+ *
+ *  @author Vicky Chen (chen-vv)
+ *  @author Eric Omielan (eomielan)
+ *  @bug No known bugs.
+ */
+
+#ifndef CONGESTION_H
+#define CONGESTION_H
+
+#include <stdint.h> // For uint32_t
+
+/**
+ * @brief Initial congestion window in packets.
+ *
+ * This constant represents the congestion window at the start of a transfer (RFC 6928).
+ */
+#define INITIAL_CWND 10
+
+/**
+ * @brief Minimum slow start threshold in packets.
+ *
+ * This constant represents the smallest value the slow start threshold is set to after a loss.
+ */
+#define MIN_SSTHRESH 2
+
+/**
+ * @brief Name of the congestion control algorithm used when none is given.
+ */
+#define DEFAULT_CONGESTION_CONTROL "newreno"
+
+/**
+ * @brief Number of round trips over which BBR keeps the largest delivery rate.
+ */
+#define BBR_BW_ROUNDS 10
+
+/**
+ * @brief A delivery rate sample, taken from the packets acknowledged by an ACK.
+ *
+ * The rate is delivered / interval. Following the delivery rate estimation
+ * draft, the interval is the longer of the time it took to send the packets
+ * and the time it took to acknowledge them, measured from the newest packet
+ * acknowledged.
+ */
+struct RateSample
+{
+    unsigned long long delivered;      /**< Bytes delivered over the interval. */
+    unsigned long long interval;       /**< Length of the interval in microseconds, or 0 if there is no sample. */
+    unsigned long long priorDelivered; /**< Total bytes delivered when the newest acknowledged packet was sent. */
+    unsigned long long priorTime;      /**< Time of the last delivery when the newest acknowledged packet was sent. */
+    unsigned long long sendElapsed;    /**< Time taken to send the packets acknowledged, in microseconds. */
+    unsigned long long ackElapsed;     /**< Time taken to acknowledge the packets, in microseconds. */
+    int appLimited;                    /**< Flag indicating if the sender ran out of data while the packets were sent. */
+};
+
+/**
+ * @brief Information about an ACK passed to the congestion control algorithm.
+ */
+struct AckEvent
+{
+    unsigned int ackedPackets;    /**< Number of packets newly acknowledged. */
+    unsigned int lostPackets;     /**< Number of packets newly considered lost. */
+    uint32_t cumulativeAck;       /**< Sequence number of the oldest unacknowledged packet. */
+    unsigned long long rtt;       /**< Round-trip time sample in microseconds, or 0 if there is none. */
+    unsigned long long now;       /**< Time the ACK was processed, in microseconds. */
+    unsigned int packetsInFlight; /**< Number of packets in flight after the ACK was processed. */
+    uint32_t nextSequenceNumber;  /**< Sequence number of the next new packet to be sent. */
+    unsigned long long delivered; /**< Total bytes delivered so far. */
+    struct RateSample rate;       /**< Delivery rate sample taken from the ACK. */
+};
+
+/**
+ * @brief Loss recovery state of a transfer.
+ */
+enum RecoveryState
+{
+    RECOVERY_OPEN,     /**< No loss is being recovered from. */
+    RECOVERY_FAST,     /**< Recovering from losses found through SACKs (fast recovery). */
+    RECOVERY_TIMEOUT,  /**< Recovering from a retransmission timeout. */
+};
+
+/**
+ * @brief State kept by the CUBIC congestion control algorithm.
+ *
+ * Times are in microseconds and windows in packets.
+ */
+struct CubicState
+{
+    unsigned int lastMaxCwnd;       /**< Window just before the last reduction (W_max). */
+    unsigned long long epochStart;  /**< Start of the current congestion avoidance epoch, or 0 if none has started. */
+    unsigned int originPoint;       /**< Window at the plateau of the cubic function. */
+    double k;                       /**< Time from the start of the epoch to the plateau, in seconds. */
+    unsigned int renoCwnd;          /**< Window a Reno sender would have, for TCP friendliness. */
+    unsigned int ackCount;          /**< Packets acknowledged towards the next increase of renoCwnd. */
+    unsigned long long minRtt;      /**< Smallest round-trip time seen, or 0 if none. */
+    int hystartFound;               /**< Flag indicating if HyStart has ended slow start. */
+    uint32_t roundEnd;              /**< The current HyStart round ends once this packet is acknowledged. */
+    unsigned long long roundStart;  /**< Start of the current HyStart round. */
+    unsigned long long lastAck;     /**< Time of the last ACK in the current ACK train. */
+    unsigned long long roundMinRtt; /**< Smallest round-trip time seen in the current round. */
+    unsigned int rttSamples;        /**< Number of round-trip time samples taken in the current round. */
+};
+
+/**
+ * @brief Operating mode of the BBR congestion control algorithm.
+ */
+enum BbrMode
+{
+    BBR_STARTUP,   /**< Doubling the sending rate every round trip to find the bottleneck bandwidth. */
+    BBR_DRAIN,     /**< Draining the queue built up during startup. */
+    BBR_PROBE_BW,  /**< Cycling the sending rate around the bottleneck bandwidth. */
+    BBR_PROBE_RTT, /**< Briefly shrinking the window to measure the minimum round-trip time. */
+};
+
+/**
+ * @brief State kept by the BBR congestion control algorithm.
+ *
+ * Times are in microseconds, rates in bytes per second and windows in packets.
+ */
+struct BbrState
+{
+    enum BbrMode mode;                             /**< Operating mode. */
+    unsigned long long bwSamples[BBR_BW_ROUNDS];   /**< Largest delivery rate seen in each of the last rounds. */
+    unsigned long long roundCount;                 /**< Number of round trips so far. */
+    unsigned long long nextRoundDelivered;         /**< The current round ends once a packet sent after this many bytes were delivered is acknowledged. */
+    int roundStart;                                /**< Flag indicating if the current ACK started a new round. */
+    unsigned long long minRtt;                     /**< Smallest round-trip time seen recently, or 0 if none. */
+    unsigned long long minRttStamp;                /**< Time minRtt was measured. */
+    double pacingGain;                             /**< Pacing rate relative to the bottleneck bandwidth. */
+    double cwndGain;                               /**< Congestion window relative to the bandwidth-delay product. */
+    unsigned long long fullBw;                     /**< Bandwidth when startup last saw significant growth. */
+    int fullBwCount;                               /**< Rounds since startup last saw significant growth. */
+    int fullBwReached;                             /**< Flag indicating if startup has found the bottleneck bandwidth. */
+    int cycleIndex;                                /**< Current phase of the PROBE_BW gain cycle. */
+    unsigned long long cycleStamp;                 /**< Start of the current PROBE_BW phase. */
+    unsigned long long probeRttDoneStamp;          /**< End of PROBE_RTT, or 0 if not yet scheduled. */
+    int probeRttRoundDone;                         /**< Flag indicating if a full round has passed in PROBE_RTT. */
+    unsigned int priorCwnd;                        /**< Window saved before loss recovery or PROBE_RTT. */
+    int packetConservation;                        /**< Flag indicating if the window follows packet conservation. */
+    enum RecoveryState previousState;              /**< Loss recovery state at the previous ACK. */
+};
+
+struct CongestionControl;
+
+/**
+ * @brief Operations implemented by a congestion control algorithm.
+ *
+ * Every algorithm provides a name, an initializer, how to compute the slow start
+ * threshold after a loss, and how to grow the congestion window on an ACK outside
+ * of loss recovery. An algorithm may also be told about retransmission timeouts.
+ * A model-based algorithm may instead take full control of the window and the
+ * pacing rate on every ACK through congControl.
+ */
+struct CongestionOps
+{
+    const char *name;                                                           /**< Name used to select the algorithm. */
+    void (*init)(struct CongestionControl *cc);                                 /**< Initializes algorithm state. */
+    unsigned int (*ssthresh)(struct CongestionControl *cc);                     /**< Returns the slow start threshold after a loss. */
+    void (*congAvoid)(struct CongestionControl *cc, const struct AckEvent *ack); /**< Grows the window on an ACK. */
+    void (*onTimeout)(struct CongestionControl *cc);                            /**< Called on a retransmission timeout, may be NULL. */
+    void (*congControl)(struct CongestionControl *cc, const struct AckEvent *ack); /**< Sets the window and pacing rate on an ACK in place of congAvoid and loss recovery, may be NULL. */
+};
+
+/**
+ * @brief Congestion control state of a transfer.
+ */
+struct CongestionControl
+{
+    const struct CongestionOps *ops; /**< The congestion control algorithm in use. */
+    unsigned int cwnd;               /**< Congestion window, in packets. */
+    unsigned int ssthresh;           /**< Slow start threshold, in packets. */
+    unsigned int cwndCount;          /**< Packets acknowledged towards the next window increase in congestion avoidance. */
+    unsigned int cwndClamp;          /**< Largest congestion window allowed, in packets. */
+    enum RecoveryState state;        /**< Loss recovery state. */
+    uint32_t recoveryPoint;          /**< Recovery ends once every packet before this sequence number is acknowledged. */
+    unsigned long long pacingRate;   /**< Rate to send packets at, in bytes per second, or 0 if the algorithm sets none. */
+    union
+    {
+        struct CubicState cubic;     /**< State of the CUBIC algorithm. */
+        struct BbrState bbr;         /**< State of the BBR algorithm. */
+    } algorithm;                     /**< State kept by the congestion control algorithm. */
+};
+
+/**
+ * @brief Looks up a congestion control algorithm by name.
+ *
+ * @param name The name of the algorithm
+ * @return The algorithm, or NULL if there is no algorithm with that name
+ */
+const struct CongestionOps *congestion_find(const char *name);
+
+/**
+ * @brief Initializes the congestion control state of a transfer.
+ *
+ * @param cc The congestion control state
+ * @param ops The congestion control algorithm to use
+ * @param cwndClamp The largest congestion window allowed, in packets
+ * @return Void
+ */
+void congestion_init(struct CongestionControl *cc, const struct CongestionOps *ops, unsigned int cwndClamp);
+
+/**
+ * @brief Updates the congestion window for an ACK.
+ *
+ * @param cc The congestion control state
+ * @param ack The ACK
+ * @return Void
+ */
+void congestion_on_ack(struct CongestionControl *cc, const struct AckEvent *ack);
+
+/**
+ * @brief Reduces the congestion window after packets were found lost through SACKs.
+ *
+ * @param cc The congestion control state
+ * @param nextSequenceNumber The sequence number of the next new packet to be sent
+ * @return Void
+ */
+void congestion_on_loss(struct CongestionControl *cc, uint32_t nextSequenceNumber);
+
+/**
+ * @brief Reduces the congestion window after a retransmission timeout.
+ *
+ * @param cc The congestion control state
+ * @param nextSequenceNumber The sequence number of the next new packet to be sent
+ * @return Void
+ */
+void congestion_on_timeout(struct CongestionControl *cc, uint32_t nextSequenceNumber);
+
+/**
+ * @brief Standard slow start: grows the window by one packet per packet acknowledged.
+ *
+ * @param cc The congestion control state
+ * @param acked The number of packets acknowledged
+ * @return The number of acknowledged packets left over once the window reaches the slow start threshold
+ */
+unsigned int congestion_slow_start(struct CongestionControl *cc, unsigned int acked);
+
+/**
+ * @brief Standard additive increase: grows the window by one packet per w packets acknowledged.
+ *
+ * @param cc The congestion control state
+ * @param w The number of packets that must be acknowledged for each one-packet increase
+ * @param acked The number of packets acknowledged
+ * @return Void
+ */
+void congestion_avoidance(struct CongestionControl *cc, unsigned int w, unsigned int acked);
+
+#endif // CONGESTION_H
@@ -0,0 +1,132 @@
+/** @file header.h
+ *  @brief Structure and function definitions for the wire format of
+ *         data packet headers.
+ *
+ *  Every data packet starts with a packed header in network byte order:
+ *
+ *      byte 0     version (high 4 bits) and flags (low 4 bits)
+ *      byte 1     header length in bytes, including extensions
+ *      bytes 2-3  length of the data that follows the header
+ *      bytes 4-7  sequence number
+ *      bytes 8-   extensions, if any
+ *
+ *  Each extension is a type byte, a length byte and that many bytes of
+ *  value. Receivers skip extensions and flags they do not know, and
+ *  find the data through the header length, so new fields can be added
+ *  without breaking older receivers. Packets with a different version
+ *  are dropped.
+ *
+ *  @author Vicky Chen (chen-vv)
+ *  @author Eric Omielan (eomielan)
+ *  @bug No known bugs.
+ */
+
+#ifndef HEADER_H
+#define HEADER_H
+
+#include <stdint.h> // For uint32_t
+
+/**
+ * @brief Version of the wire format written by this implementation.
+ */
+#define PROTOCOL_VERSION 1
+
+/**
+ * @brief Size of the fixed part of the header in bytes.
+ */
+#define HEADER_SIZE 8
+
+/**
+ * @brief Largest header in bytes, including extensions.
+ */
+#define MAX_HEADER_SIZE 64
+
+/**
+ * @brief Header flag marking the last packet of the file.
+ */
+#define HEADER_FLAG_LAST_PACKET 0x1
+
+/**
+ * @brief Size of the type and length fields of an extension in bytes.
+ */
+#define EXTENSION_HEADER_SIZE 2
+
+/**
+ * @brief Type of the extension carrying the sender's connection ID.
+ *
+ * The value is the 4-byte connection ID in network byte order. The sender
+ * puts it first, so it sits at bytes 10-13 of every data packet, where a
+ * receiver shared by many senders finds the transfer the packet belongs to.
+ */
+#define HEADER_EXTENSION_CONNECTION_ID 1
+
+/**
+ * @brief Type of the extension carrying the offset of the packet's data in the file.
+ *
+ * The value is the 8-byte offset in network byte order. Only the packets of a
+ * striped transfer carry it, as each sub-flow sends pieces from all over the file.
+ */
+#define HEADER_EXTENSION_OFFSET 2
+
+/**
+ * @brief Offset of the connection ID in a data packet, when it is the first extension.
+ */
+#define CONNECTION_ID_OFFSET (HEADER_SIZE + EXTENSION_HEADER_SIZE)
+
+/**
+ * @brief Header of a data packet, as decoded from the wire.
+ */
+struct Header
+{
+    uint32_t sequenceNumber; /**< Sequence number of the packet. */
+    uint32_t messageLength;  /**< Length of the message data in the packet. */
+    u_char lastPacket;       /**< Flag indicating if it's the last packet (0 for false, 1 for true). */
+};
+
+/**
+ * @brief Writes the fixed part of a header, without extensions.
+ *
+ * @param header The header to write
+ * @param buffer The start of the packet
+ * @return The length of the header in bytes
+ */
+int header_encode(const struct Header *header, char *buffer);
+
+/**
+ * @brief Appends an extension to a header written by header_encode.
+ *
+ * Extensions must be added before the data is placed after the header, as
+ * they move the start of the data.
+ *
+ * @param buffer The start of the packet
+ * @param type The type of the extension
+ * @param value The value of the extension
+ * @param length The length of the value in bytes
+ * @return The new length of the header in bytes, or -1 if it would exceed MAX_HEADER_SIZE
+ */
+int header_add_extension(char *buffer, uint8_t type, const void *value, uint8_t length);
+
+/**
+ * @brief Reads and validates the header of a received packet.
+ *
+ * The packet is rejected if it has a different version, a malformed
+ * extension, or a data length that does not match the packet length.
+ *
+ * @param header Filled in with the decoded header
+ * @param buffer The start of the packet
+ * @param length The length of the packet in bytes
+ * @return The length of the header in bytes (the offset of the data), or -1 if the packet is invalid
+ */
+int header_decode(struct Header *header, const char *buffer, int length);
+
+/**
+ * @brief Finds an extension in a header validated by header_decode.
+ *
+ * @param buffer The start of the packet
+ * @param type The type of the extension
+ * @param length Set to the length of the value in bytes, if the extension is found
+ * @return The value of the extension, or NULL if the header has no extension of that type
+ */
+const void *header_find_extension(const char *buffer, uint8_t type, uint8_t *length);
+
+#endif // HEADER_H
@@ -0,0 +1,87 @@
+/** @file pacer.h
+ *  @brief Structure and function definitions for the packet pacer
+ *         used by the sender.
+ *
+ *  The pacer spreads packets evenly over time at a target rate instead
+ *  of sending a whole window back to back. Each packet pushes the
+ *  earliest time the next one may be sent forward by its length divided
+ *  by the rate. Credit left over while the sender had nothing to send
+ *  allows a small burst, so timer wakeups that are a little late do not
+ *  lower the rate.
+ *
+ *  @author Vicky Chen (chen-vv)
+ *  @author Eric Omielan (eomielan)
+ *  @bug No known bugs.
+ */
+
+#ifndef PACER_H
+#define PACER_H
+
+/**
+ * @brief Number of full packets the pacer allows to be sent back to back.
+ */
+#define PACING_BURST 4
+
+/**
+ * @brief Pacing rate relative to the congestion window per round trip in slow start.
+ *
+ * Pacing a window-based algorithm at exactly cwnd per round trip would stop the
+ * window from growing, so the rate is scaled up while the window is.
+ */
+#define PACING_SLOW_START_GAIN 2.0
+
+/**
+ * @brief Pacing rate relative to the congestion window per round trip in congestion avoidance.
+ */
+#define PACING_CONGESTION_AVOIDANCE_GAIN 1.2
+
+/**
+ * @brief Pacing state of a transfer.
+ *
+ * Times are in nanoseconds.
+ */
+struct Pacer
+{
+    unsigned long long rate;         /**< Rate to send at, in bytes per second, or 0 to not pace. */
+    unsigned long long nextSendTime; /**< Earliest time the next packet may be sent. */
+    unsigned int burst;              /**< Number of bytes that may be sent back to back. */
+};
+
+/**
+ * @brief Initializes the pacing state of a transfer.
+ *
+ * @param pacer The pacing state
+ * @param burst The number of bytes that may be sent back to back
+ * @return Void
+ */
+void pacer_init(struct Pacer *pacer, unsigned int burst);
+
+/**
+ * @brief Changes the rate packets are sent at.
+ *
+ * @param pacer The pacing state
+ * @param rate The rate, in bytes per second, or 0 to stop pacing
+ * @return Void
+ */
+void pacer_set_rate(struct Pacer *pacer, unsigned long long rate);
+
+/**
+ * @brief Returns how long to wait before the next packet may be sent.
+ *
+ * @param pacer The pacing state
+ * @param now The current time, in nanoseconds
+ * @return The time to wait, in nanoseconds, or 0 if a packet may be sent now
+ */
+unsigned long long pacer_delay(const struct Pacer *pacer, unsigned long long now);
+
+/**
+ * @brief Accounts for a packet that was just sent.
+ *
+ * @param pacer The pacing state
+ * @param now The current time, in nanoseconds
+ * @param bytes The length of the packet, in bytes
+ * @return Void
+ */
+void pacer_on_send(struct Pacer *pacer, unsigned long long now, unsigned int bytes);
+
+#endif // PACER_H
@@ -0,0 +1,125 @@
+/** @file ring.h
+ *  @brief Structure and function definitions for a lock-free
+ *         single-producer/single-consumer ring of buffers.
+ *
+ *  One thread fills buffers and hands them over, and another thread
+ *  consumes them and hands them back, with no locks: each side only
+ *  advances its own end of the ring. A side with nothing to do sleeps on
+ *  a futex until the other wakes it. The receiver's writer thread and the
+ *  sender's reader thread both pass packet data through one of these.
+ *
+ *  @author Vicky Chen (chen-vv)
+ *  @author Eric Omielan (eomielan)
+ *  @bug No known bugs.
+ */
+
+#ifndef RING_H
+#define RING_H
+
+#include <stddef.h> // For size_t
+#include <stdint.h> // For uint32_t
+
+/**
+ * @brief A ring of fixed-size buffers shared by a producer thread and a consumer thread.
+ *
+ * The positions only ever increase and wrap around; a position's buffer is
+ * found with ring_slot. The producer owns tail and reserved, and the consumer
+ * owns head, each on its own cache line.
+ */
+struct Ring
+{
+    char *slots;                                      /**< The buffers, one after another. */
+    size_t slotSize;                                  /**< Size of each buffer, in bytes. */
+    unsigned entries;                                 /**< Number of buffers, a power of two. */
+    uint32_t head __attribute__((aligned(64)));       /**< Position of the oldest buffer not yet given back. */
+    int producerWaiting;                              /**< Flag indicating if the producer sleeps on spaceSignal. */
+    uint32_t spaceSignal;                             /**< Futex bumped when buffers are given back to a sleeping producer. */
+    uint32_t tail __attribute__((aligned(64)));       /**< Position after the last buffer handed to the consumer. */
+    uint32_t reserved;                                /**< Position after the last buffer handed out by ring_reserve. */
+    int closed;                                       /**< Flag indicating that no more buffers will be handed over. */
+    int consumerWaiting;                              /**< Flag indicating if the consumer sleeps on dataSignal. */
+    uint32_t dataSignal;                              /**< Futex bumped when buffers are handed to a sleeping consumer. */
+};
+
+/**
+ * @brief Allocates the buffers of a ring.
+ *
+ * @param ring The ring to set up
+ * @param entries The number of buffers, a power of two
+ * @param slotSize The size of each buffer, in bytes
+ * @return Void
+ */
+void ring_init(struct Ring *ring, unsigned entries, size_t slotSize);
+
+/**
+ * @brief Gets the buffer at a position.
+ *
+ * @param ring The ring
+ * @param position The position
+ * @return The buffer
+ */
+void *ring_slot(struct Ring *ring, uint32_t position);
+
+/**
+ * @brief Gets the next free buffer for the producer to fill.
+ *
+ * The buffer is handed to the consumer by ring_commit. If the ring is full,
+ * the buffers filled so far are handed over, and the call sleeps until the
+ * consumer gives a buffer back.
+ *
+ * @param ring The ring
+ * @return The buffer
+ */
+void *ring_reserve(struct Ring *ring);
+
+/**
+ * @brief Hands every buffer filled since the last call to the consumer.
+ *
+ * @param ring The ring
+ * @return Void
+ */
+void ring_commit(struct Ring *ring);
+
+/**
+ * @brief Hands over the remaining buffers, and tells the consumer that no more will follow.
+ *
+ * @param ring The ring
+ * @return Void
+ */
+void ring_close(struct Ring *ring);
+
+/**
+ * @brief Returns the number of buffers the producer can reserve without waiting.
+ *
+ * @param ring The ring
+ * @return The number of free buffers
+ */
+unsigned ring_space(struct Ring *ring);
+
+/**
+ * @brief Waits until the producer has handed over the buffer at a position.
+ *
+ * @param ring The ring
+ * @param position The position of the next buffer the consumer wants
+ * @return The tail, which equals position only if the ring is closed and there is nothing left
+ */
+uint32_t ring_wait(struct Ring *ring, uint32_t position);
+
+/**
+ * @brief Gives every buffer before a position back to the producer.
+ *
+ * @param ring The ring
+ * @param position The position after the last buffer the consumer is done with
+ * @return Void
+ */
+void ring_release(struct Ring *ring, uint32_t position);
+
+/**
+ * @brief Frees the buffers of a ring once neither thread uses it.
+ *
+ * @param ring The ring
+ * @return Void
+ */
+void ring_destroy(struct Ring *ring);
+
+#endif // RING_H
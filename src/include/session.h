@@ -0,0 +1,144 @@
+/** @file session.h
+ *  @brief Structure and function definitions for the receiver's
+ *         transfer sessions.
+ *
+ *  A session holds everything the receiver knows about one transfer:
+ *  what the SYN announced, the packets received so far, and the file
+ *  they are written to. A receiver run for a single transfer has one
+ *  session. A receiver daemon keeps one per sender in a session table,
+ *  found by the connection ID each sender picks and puts in every
+ *  packet, so many transfers can share one port. Each worker thread of
+ *  the daemon has a table of its own.
+ *
+ *  @author Vicky Chen (chen-vv)
+ *  @author Eric Omielan (eomielan)
+ *  @bug No known bugs.
+ */
+
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <netinet/in.h> // For struct sockaddr_in
+#include <pthread.h>    // For pthread_t
+#include <stdint.h>     // For uint32_t
+#include <sys/socket.h> // For CMSG_SPACE
+
+#include "bucket.h"
+#include "udp.h"
+#include "writer.h"
+
+/**
+ * @brief The receiver's state for one transfer.
+ */
+struct Session
+{
+    uint32_t connectionId;                  /**< Connection ID the sender picked, or 0 if it sent none. */
+    uint32_t transferId;                    /**< ID of the striped transfer the session is a sub-flow of, or 0. */
+    struct sockaddr_in address;             /**< Address of the sender. */
+    socklen_t addressLength;                /**< Length of the address. */
+    int fd;                                 /**< The file being written. */
+    int seekable;                           /**< Flag indicating if the file can be written at any offset, as a regular file can. */
+    uint32_t latestSequenceNumber;          /**< Sequence number of the newest packet written; packets up to it are duplicates. */
+    uint32_t firstSequenceNumber;           /**< Sequence number of the sender's first data packet. */
+    uint32_t packetDataSize;                /**< Data bytes in every data packet but the last, as announced in the SYN, or 0. */
+    unsigned long long transferSize;        /**< Bytes the sender announced it will send, or 0 if it did not. */
+    int positionalWrites;                   /**< Flag indicating if each packet's data is written as soon as it arrives. */
+    struct BufferedPacket *reorderBuffer;   /**< Packets that arrived ahead of a missing packet, REORDER_BUFFER_SIZE entries. */
+    struct Writer writer;                   /**< The writer thread, unless io_uring writes the file. */
+    struct TokenBucket writeBucket;         /**< Holds writes to the file to writeRate; its rate is 0 if writes are not limited. */
+    uint32_t advertisedWindow;              /**< Window advertised in the most recent ACK. */
+    unsigned long long bytesWritten;        /**< Number of bytes handed to be written so far. */
+    uint32_t synAckSequenceNumber;          /**< Sequence number of the SYN-ACK sent back. */
+    int finished;                           /**< Flag indicating if the last packet has been written. */
+    unsigned long long lastActivity;        /**< Time the last packet of the session arrived, in nanoseconds. */
+};
+
+/**
+ * @brief The buffers a batch of datagrams is received into with recvmmsg.
+ *
+ * These are allocated by the thread that receives into them, so that other
+ * threads, such as the writer threads, do not get a copy of their own.
+ */
+struct ReceiveBatch
+{
+    char buffers[RECEIVE_BATCH_SIZE][GRO_BUFFER_SIZE];   /**< The datagrams; with UDP GRO, each may hold several packets. */
+    union
+    {
+        char buffer[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } controls[RECEIVE_BATCH_SIZE];                       /**< The control data (the GRO segment size) of each datagram. */
+    struct sockaddr_in addresses[RECEIVE_BATCH_SIZE];     /**< The address each datagram came from. */
+};
+
+/**
+ * @brief A table of sessions found by connection ID.
+ *
+ * The table uses open addressing with linear probing, and holds at most half
+ * as many sessions as it has entries, so lookups stay short.
+ */
+struct SessionTable
+{
+    struct Session **entries;   /**< The sessions, or NULL for empty entries. */
+    unsigned size;              /**< Number of entries, a power of two. */
+    unsigned shift;             /**< 32 minus the base 2 logarithm of the size, to keep the top bits of a hash. */
+    unsigned count;             /**< Number of sessions in the table. */
+};
+
+/**
+ * @brief A worker thread of the receiver daemon, with its own socket and sessions.
+ */
+struct Worker
+{
+    pthread_t thread;                /**< The thread, unless the worker runs on the main thread. */
+    unsigned index;                  /**< Index of the worker, and of its socket in the port's SO_REUSEPORT group. */
+    int sockfd;                      /**< The worker's socket. */
+    struct SessionTable sessions;    /**< The sessions the kernel steers to the worker's socket. */
+    char *directory;                 /**< Directory the files of the sessions are written to. */
+    unsigned long long writeRate;    /**< Maximum number of bytes each session writes per second, or 0 for no limit. */
+};
+
+/**
+ * @brief Allocates a session table.
+ *
+ * @param table The session table to set up
+ * @param maxSessions The largest number of sessions the table holds
+ * @return Void
+ */
+void session_table_init(struct SessionTable *table, unsigned maxSessions);
+
+/**
+ * @brief Finds the session with a connection ID.
+ *
+ * @param table The session table
+ * @param connectionId The connection ID
+ * @return The session, or NULL if there is none
+ */
+struct Session *session_find(struct SessionTable *table, uint32_t connectionId);
+
+/**
+ * @brief Adds a session to the table, unless the table is full.
+ *
+ * @param table The session table
+ * @param session The session, with a connection ID not already in the table
+ * @return 0 on success, or -1 if the table is full
+ */
+int session_insert(struct SessionTable *table, struct Session *session);
+
+/**
+ * @brief Removes a session from the table.
+ *
+ * @param table The session table
+ * @param session The session, which must be in the table
+ * @return Void
+ */
+void session_remove(struct SessionTable *table, struct Session *session);
+
+/**
+ * @brief Frees a session table, which must be empty.
+ *
+ * @param table The session table
+ * @return Void
+ */
+void session_table_destroy(struct SessionTable *table);
+
+#endif // SESSION_H
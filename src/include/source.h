@@ -0,0 +1,131 @@
+/** @file source.h
+ *  @brief Structure and function definitions for reading the file
+ *         sent by the sender.
+ *
+ *  A regular file is mapped into memory, so the data of each packet is
+ *  sent straight from the mapping (the page cache) without being copied
+ *  into the packet first. Files that cannot be mapped, such as pipes,
+ *  are read ahead by a reader thread into a fixed pool of packet
+ *  buffers instead, so the sender never waits on a read between an ACK
+ *  and the next send.
+ *
+ *  @author Vicky Chen (chen-vv)
+ *  @author Eric Omielan (eomielan)
+ *  @bug No known bugs.
+ */
+
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <pthread.h> // For pthread_t
+#include <stddef.h>  // For size_t
+#include <stdio.h>   // For FILE
+
+#include "ring.h"
+
+struct StripeSet;
+
+/**
+ * @brief A chunk of the file read ahead by the reader thread.
+ */
+struct ReadChunk
+{
+    unsigned int length;  /**< Number of bytes of data. */
+    int last;             /**< Flag indicating if this is the end of the data to send. */
+    char data[];          /**< The data, up to the chunk size of the source. */
+};
+
+/**
+ * @brief The file being sent.
+ */
+struct FileSource
+{
+    FILE *file;                   /**< The open file. */
+    const char *map;              /**< The mapping of the file, or NULL if it is read with buffered reads. */
+    unsigned long long length;    /**< Number of bytes to send. */
+    unsigned long long offset;    /**< Number of bytes handed out by source_read so far. */
+    int knownLength;              /**< Flag indicating if length is the size of the data, as it is for a regular file. */
+    struct Ring pool;             /**< The pool of struct ReadChunk buffers, if the file is not mapped. */
+    pthread_t reader;             /**< The reader thread, if the file is not mapped. */
+    size_t chunkSize;             /**< Number of bytes the reader thread reads into each chunk. */
+    uint32_t readPosition;        /**< Position in the pool of the next chunk source_read hands out. */
+    unsigned long long position;  /**< Offset in the file of the chunk source_read handed out last. */
+    int done;                     /**< Flag indicating if the chunk source_read handed out last ends the data to send. */
+    struct StripeSet *stripes;    /**< The ranges of the file shared out among sub-flows, if this is a sub-flow's view. */
+    unsigned stripe;              /**< Index of the sub-flow this view hands out data for. */
+    unsigned long long pieceNext; /**< Offset of the next byte of the piece the sub-flow is sending. */
+    unsigned long long pieceEnd;  /**< Offset just past the piece the sub-flow is sending. */
+};
+
+/**
+ * @brief Opens the file to send.
+ *
+ * At most bytesToTransfer bytes are sent. For a regular file, this is also
+ * capped at the size of the file, and the file is mapped into memory unless
+ * useMap is clear or mapping fails. A file that is not mapped is read by a
+ * reader thread into a pool of poolEntries chunks, which bounds the memory
+ * used for file data no matter how far the reader gets ahead.
+ *
+ * @param source The file source to initialize
+ * @param filename The name of the file
+ * @param bytesToTransfer The number of bytes to send
+ * @param useMap Flag indicating if the file should be mapped into memory
+ * @param chunkSize The number of bytes in each chunk
+ * @param poolEntries The number of chunks in the pool, a power of two
+ * @return Void
+ */
+void source_open(struct FileSource *source, const char *filename, unsigned long long bytesToTransfer, int useMap,
+                 size_t chunkSize, unsigned poolEntries);
+
+/**
+ * @brief Sets up a sub-flow's view of a mapped file, which hands out the pieces the sub-flow takes.
+ *
+ * The view shares the mapping of the file and must not be closed; the file
+ * itself is closed once every sub-flow is done.
+ *
+ * @param view The view to initialize
+ * @param source The mapped file
+ * @param stripes The ranges of the file shared out among the sub-flows
+ * @param index The index of the sub-flow
+ * @return TRUE if the sub-flow has something to send, FALSE if every byte has been taken already
+ */
+int source_stripe(struct FileSource *view, const struct FileSource *source, struct StripeSet *stripes, unsigned index);
+
+/**
+ * @brief Gets the next chunk of the file.
+ *
+ * If the file is mapped, data is pointed into the mapping and nothing is
+ * copied. Otherwise, data points to the next chunk in the pool, waiting for
+ * the reader thread only if it has fallen behind. Fewer than chunkSize bytes
+ * are returned only at the end of the data to send, or of a piece of a
+ * sub-flow. A mapped chunk stays valid until source_close, and a pooled
+ * chunk until source_release gives it back.
+ *
+ * @param source The file source
+ * @param data Set to the chunk
+ * @return The number of bytes in the chunk
+ */
+size_t source_read(struct FileSource *source, const char **data);
+
+/**
+ * @brief Gives the oldest chunk handed out by source_read back to the reader thread.
+ *
+ * Chunks are given back in the order they were handed out. Nothing needs to
+ * be given back for a mapped file.
+ *
+ * @param source The file source
+ * @return Void
+ */
+void source_release(struct FileSource *source);
+
+/**
+ * @brief Unmaps and closes the file, stopping the reader thread.
+ *
+ * Every chunk, up to the end of the data, must have been read first.
+ *
+ * @param source The file source
+ * @return Void
+ */
+void source_close(struct FileSource *source);
+
+#endif // SOURCE_H
@@ -0,0 +1,96 @@
+/** @file stripe.h
+ *  @brief Structure and function definitions for sending one file
+ *         over several sub-flows at once.
+ *
+ *  A striped transfer splits the file into one byte range per sub-flow.
+ *  Each sub-flow is a connection of its own, with its own socket, thread
+ *  and congestion control, and takes its range a piece at a time. A
+ *  sub-flow that runs out of data steals the back half of what is left
+ *  of the largest range, so a slow sub-flow never holds up the end of the
+ *  transfer by more than the piece it is sending.
+ *
+ *  @author Vicky Chen (chen-vv)
+ *  @author Eric Omielan (eomielan)
+ *  @bug No known bugs.
+ */
+
+#ifndef STRIPE_H
+#define STRIPE_H
+
+#include <netinet/in.h> // For struct sockaddr_in
+#include <pthread.h>    // For pthread_mutex_t
+
+#include "source.h"
+
+/**
+ * @brief The part of the file a sub-flow has not taken yet.
+ */
+struct StripeRange
+{
+    unsigned long long next;   /**< Offset of the first byte not taken yet. */
+    unsigned long long end;    /**< Offset just past the range. */
+};
+
+/**
+ * @brief The ranges of a file shared out among the sub-flows sending it.
+ *
+ * The lock is only taken once per piece, not for every packet.
+ */
+struct StripeSet
+{
+    pthread_mutex_t lock;           /**< Protects the ranges. */
+    struct StripeRange *ranges;     /**< The range of every sub-flow. */
+    unsigned count;                 /**< Number of sub-flows. */
+    unsigned long long pieceSize;   /**< Largest number of bytes a sub-flow takes at a time. */
+    unsigned long long granule;     /**< Ranges are split at multiples of this many bytes, the packet data size. */
+    unsigned steals;                /**< Number of times a sub-flow took over part of another's range. */
+};
+
+/**
+ * @brief A sub-flow of a striped transfer.
+ */
+struct SubFlow
+{
+    pthread_t thread;               /**< The thread sending the sub-flow. */
+    int started;                    /**< Flag indicating if the sub-flow had any data to send. */
+    struct sockaddr_in address;     /**< Address of the receiver. */
+    struct FileSource source;       /**< The sub-flow's view of the file. */
+    unsigned long long rateLimit;   /**< Most bytes the sub-flow sends per second, or 0 for no limit. */
+};
+
+/**
+ * @brief Splits a file into equal ranges, one per sub-flow.
+ *
+ * @param set The stripe set to initialize
+ * @param length The number of bytes to send
+ * @param count The number of sub-flows
+ * @param pieceSize The largest number of bytes a sub-flow takes at a time
+ * @param granule The ranges are split at multiples of this many bytes
+ * @return Void
+ */
+void stripe_init(struct StripeSet *set, unsigned long long length, unsigned count, unsigned long long pieceSize,
+                 unsigned long long granule);
+
+/**
+ * @brief Takes the next piece of the file for a sub-flow to send.
+ *
+ * The piece comes from the front of the sub-flow's own range. Once that is
+ * empty, the back half of the largest range left is moved to the sub-flow first.
+ *
+ * @param set The stripe set
+ * @param index The index of the sub-flow
+ * @param start Set to the offset of the piece
+ * @param end Set to the offset just past the piece
+ * @return TRUE if a piece was taken, FALSE if every byte of the file has been taken
+ */
+int stripe_next(struct StripeSet *set, unsigned index, unsigned long long *start, unsigned long long *end);
+
+/**
+ * @brief Frees a stripe set.
+ *
+ * @param set The stripe set
+ * @return Void
+ */
+void stripe_destroy(struct StripeSet *set);
+
+#endif // STRIPE_H
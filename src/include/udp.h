@@ -11,6 +11,9 @@
 #define UDP_H
 
 #include <stdint.h> // For uint32_t
+#include <stddef.h> // For offsetof
+
+#include "header.h"
 
 /**
  * @brief Represents the boolean value "false".
@@ -29,40 +32,286 @@
 #define TRUE 1
 
 /**
- * @brief Size of the header structure in bytes.
+ * @brief Maximum buffer size in bytes.
  *
- * This constant represents the size of the header structure (struct Header) in bytes.
+ * This constant defines the maximum size of the buffer used for packet data in bytes.
  */
-#define HEADER_SIZE sizeof(struct Header)
+#define MAX_BUFFER_SIZE 8192
 
 /**
- * @brief Maximum buffer size in bytes.
+ * @brief Largest data packet in bytes.
  *
- * This constant defines the maximum size of the buffer used for packet data in bytes.
+ * Data packets are sized to their data, so only full packets reach this size.
  */
-#define MAX_BUFFER_SIZE 8192
+#define MAX_PACKET_SIZE (MAX_HEADER_SIZE + MAX_BUFFER_SIZE)
 
 /**
- * @brief Default timeout value in milliseconds.
+ * @brief Default timeout value in microseconds.
  *
- * This constant represents the default timeout value used in network operations, measured in milliseconds.
+ * This constant represents the retransmission timeout used by the sender before it has measured
+ * the round-trip time to the receiver, measured in microseconds.
  */
 #define DEFAULT_TIMEOUT 100000
 
 /**
- * @brief Maximum number of retries.
+ * @brief Minimum retransmission timeout in microseconds.
+ *
+ * The retransmission timeout computed from the measured round-trip time is never shorter than this,
+ * so that small delays on the receiver do not trigger spurious retransmissions.
+ */
+#define MIN_TIMEOUT 5000
+
+/**
+ * @brief Default maximum retransmission timeout in microseconds.
+ *
+ * The retransmission timeout of a packet doubles every time the packet times out, up to this value.
+ * It can be changed on the command line.
+ */
+#define MAX_TIMEOUT 1000000
+
+/**
+ * @brief Default maximum number of retries.
+ *
+ * This constant defines the number of times a single packet may time out before the file transfer is
+ * considered a failure. It can be changed on the command line, where 0 means to retry forever.
+ */
+#define MAX_RETRIES 10
+
+/**
+ * @brief Default sender window size in packets.
+ *
+ * This constant defines how many data packets the sender may have in flight (sent but not yet
+ * acknowledged) at once when no window size is given on the command line.
+ */
+#define DEFAULT_WINDOW_SIZE 64
+
+/**
+ * @brief Largest number of datagrams sent with a single sendmmsg call.
+ */
+#define SEND_BATCH_SIZE 32
+
+/**
+ * @brief Largest UDP payload of a GSO super-buffer, in bytes.
+ *
+ * A super-buffer is a single UDP send that the kernel splits into datagrams,
+ * so it is bounded by the largest UDP payload over IPv4.
+ */
+#define GSO_MAX_SIZE 65507
+
+/**
+ * @brief Largest number of datagrams in a GSO super-buffer (UDP_MAX_SEGMENTS in the kernel).
+ */
+#define GSO_MAX_SEGMENTS 64
+
+/**
+ * @brief Largest number of MSG_ZEROCOPY sends whose completion the sender waits on at once.
+ *
+ * Must be a power of two so that the completion ring index stays consistent when
+ * send IDs wrap around.
+ */
+#define ZEROCOPY_MAX_PENDING 1024
+
+/**
+ * @brief Number of submission queue entries of the sender's io_uring.
+ */
+#define URING_ENTRIES 256
+
+/**
+ * @brief Number of ACK receives the sender's io_uring keeps outstanding.
+ */
+#define URING_ACK_BUFFERS 32
+
+/**
+ * @brief Number of buffers in the receiver's io_uring buffer ring, a power of two.
+ *
+ * Each buffer holds one datagram, which may have been coalesced by UDP GRO.
+ */
+#define URING_RECEIVE_BUFFERS 64
+
+/**
+ * @brief Number of ACKs the receiver's io_uring may be sending at once.
+ */
+#define URING_ACK_SLOTS 128
+
+/**
+ * @brief Kinds of io_uring requests made by the receiver.
+ *
+ * The kind is kept in the upper 32 bits of a request's user data, and the index
+ * of the buffer, reorder buffer entry or ACK slot it uses in the lower 32 bits.
+ */
+enum UringRequest
+{
+    URING_RECEIVE = 1, /**< The multishot receive of data packets. */
+    URING_WRITE,       /**< A write of a packet's data to the file. */
+    URING_ACK,         /**< A send of an ACK. */
+};
+
+/**
+ * @brief Size of a memory page, used to count the pages a MSG_ZEROCOPY send pins.
+ */
+#define ZEROCOPY_PAGE_SIZE 4096
+
+/**
+ * @brief Largest number of pinned pages a single MSG_ZEROCOPY send may refer to (MAX_SKB_FRAGS in the kernel).
+ *
+ * A GSO super-buffer that refers to more pages is refused, so super-buffers are kept small enough.
+ */
+#define ZEROCOPY_MAX_FRAGMENTS 17
+
+/**
+ * @brief Smallest amount of data a packet may carry when the packet size is given on the command line, in bytes.
+ */
+#define MIN_BUFFER_SIZE 64
+
+/**
+ * @brief Size of each receive buffer, large enough for a datagram coalesced by UDP GRO.
+ */
+#define GRO_BUFFER_SIZE 65536
+
+/**
+ * @brief Most packets whose data the receiver's writer thread writes to the file with a single pwritev call.
+ *
+ * Only packets whose data goes one after another in the file are written together.
+ */
+#define WRITE_BATCH_SIZE 64
+
+/**
+ * @brief Number of packets waiting to be written that the receiver's writer thread can hold, a power of two.
+ *
+ * The receiver advertises the free room in this ring to the sender in every ACK.
+ */
+#define WRITER_RING_SIZE 1024
+
+/**
+ * @brief Longest time of writing at writeRate the receiver allows in one burst, in nanoseconds.
  *
- * This constant defines the maximum number of retry attempts allowed for network operations before
- * the file transfer is considered a failure.
+ * This is the capacity of the token bucket that holds the receiver to writeRate.
  */
-#define MAX_RETRIES 3
+#define WRITE_BURST_TIME 100000000ULL
+
+/**
+ * @brief Longest time of sending at the sender's rate limit allowed in one burst, in nanoseconds.
+ *
+ * This is the capacity of the token bucket that holds the sender to its rate limit,
+ * but it always holds at least PACING_BURST full packets.
+ */
+#define RATE_LIMIT_BURST_TIME 1000000ULL
+
+/**
+ * @brief Longest time the receiver waits for a packet before checking whether its window has reopened, in microseconds.
+ *
+ * A receiver that advertised a closed window sends a window update once it has room
+ * again, so the sender does not have to wait for its zero-window probe.
+ */
+#define WINDOW_UPDATE_INTERVAL 10000
+
+/**
+ * @brief Number of chunks the sender's reader thread can read beyond the window.
+ *
+ * The pool of chunks holds the data of every packet in the window, which
+ * retransmissions are sent from, plus this many chunks read ahead.
+ */
+#define READ_AHEAD_CHUNKS 64
+
+/**
+ * @brief Largest number of sub-flows a file may be sent over (-S).
+ */
+#define MAX_STRIPES 64
+
+/**
+ * @brief Number of packets a sub-flow of a striped transfer takes from its range at a time.
+ *
+ * Once every range is empty, each sub-flow only has the piece it took left
+ * to send, so this bounds how far a slow sub-flow trails the others.
+ */
+#define STRIPE_PIECE_PACKETS 64
+
+/**
+ * @brief Largest number of datagrams received with a single recvmmsg call.
+ *
+ * The ACKs for the packets received in one call are also sent with a single sendmmsg call.
+ */
+#define RECEIVE_BATCH_SIZE 32
+
+/**
+ * @brief Number of packets the receiver can hold while waiting for a missing packet.
+ *
+ * Packets that arrive out of order are kept in a reorder buffer of this many packets until
+ * the packets before them arrive. Must be a power of two so that the buffer index stays
+ * consistent when sequence numbers wrap around.
+ */
+#define REORDER_BUFFER_SIZE 256
+
+/**
+ * @brief Time the receiver keeps answering retransmissions after the last packet, in microseconds.
+ *
+ * If the ACK for the last packet is lost, the sender retransmits it after DEFAULT_TIMEOUT. The
+ * receiver waits for a quiet period of a few timeouts before exiting so that it can ACK again.
+ */
+#define LINGER_TIMEOUT (3 * DEFAULT_TIMEOUT)
+
+/**
+ * @brief Largest number of transfers each worker thread of a receiver daemon (-D) handles at once.
+ *
+ * A SYN for a new transfer is ignored while the daemon is full, so the sender
+ * retries it until a session ends.
+ */
+#define MAX_SESSIONS 64
+
+/**
+ * @brief Largest number of worker threads of a receiver daemon (-T).
+ *
+ * Each worker handles up to MAX_SESSIONS transfers of its own.
+ */
+#define MAX_WORKERS 64
+
+/**
+ * @brief Time after which a receiver daemon gives up on a transfer that went silent, in microseconds.
+ *
+ * A sender gives up well before this by default, after MAX_RETRIES timeouts, so a session
+ * this idle almost always belongs to a sender that is gone.
+ */
+#define SESSION_IDLE_TIMEOUT 30000000ULL
+
+/**
+ * @brief Receive buffer size requested for the receiver's socket, in bytes.
+ *
+ * A pipelined sender can deliver a whole window back-to-back, so the receiver asks the kernel
+ * for a socket buffer large enough to hold it. The kernel caps the request at net.core.rmem_max.
+ */
+#define RECEIVE_BUFFER_SIZE (4 * 1024 * 1024)
+
+/**
+ * @brief Maximum number of SACK blocks carried by an ACK packet.
+ *
+ * This constant defines how many ranges of out-of-order packets the receiver reports in
+ * each acknowledgment packet.
+ */
+#define MAX_SACK_BLOCKS 8
 
 /**
  * @brief Size of the acknowledgment packet in bytes.
  *
- * This constant represents the size of the acknowledgment packet (ACK) in bytes.
+ * This constant represents the maximum size of the acknowledgment packet (ACK) in bytes,
+ * which is reached when every SACK block is used.
+ */
+#define MAX_ACK_SIZE sizeof(struct Ack)
+
+/**
+ * @brief Size of the acknowledgment packet without any SACK blocks, in bytes.
+ *
+ * Only the SACK blocks that are in use are sent, so an ACK packet carrying n SACK blocks
+ * is ACK_HEADER_SIZE + n * sizeof(struct SackBlock) bytes long.
+ */
+#define ACK_HEADER_SIZE offsetof(struct Ack, sacks)
+
+/**
+ * @brief Number of later packets that must be acknowledged before a packet is considered lost.
+ *
+ * Once this many packets sent after an unacknowledged packet have been selectively
+ * acknowledged, the sender retransmits the packet without waiting for its timeout.
  */
-#define MAX_ACK_SIZE sizeof(uint32_t)
+#define DUPLICATE_THRESHOLD 3
 
 /**
  * @brief Default timeout value for SYN-ACK packets in milliseconds.
@@ -81,46 +330,77 @@
 #define SYN_ACK_MAX_TIMEOUT_MILLISEC 1600
 
 /**
- * @brief Header structure for packet data.
+ * @brief Checks whether sequence number a comes before sequence number b.
  *
- * This structure represents the header used for packet data transmission.
- * It contains fields for the sequence number, message length, and a flag indicating if it's the last packet.
+ * Sequence numbers start at a random value and are allowed to wrap around, so they are
+ * compared using the sign of their 32-bit difference rather than with a plain "<".
+ */
+#define SEQ_LT(a, b) ((int32_t)((uint32_t)(a) - (uint32_t)(b)) < 0)
+
+/**
+ * @brief Checks whether sequence number a comes before or is equal to sequence number b.
  *
+ * See SEQ_LT for how wrap-around is handled.
  */
-struct Header
-{
-    uint32_t sequenceNumber; /**< Sequence number of the packet. */
-    uint32_t messageLength;  /**< Length of the message data in the packet. */
-    u_char lastPacket;       /**< Flag indicating if it's the last packet (0 for false, 1 for true). */
-};
+#define SEQ_LEQ(a, b) ((int32_t)((uint32_t)(a) - (uint32_t)(b)) <= 0)
 
 /**
  * @brief SYN packet structure.
  *
  * This structure represents the SYN packet used in the three-way handshake process.
- * It contains the sequence number.
+ * It contains the sequence number, and tells the receiver how the data is split into
+ * packets, so that the receiver can work out where each packet's data goes in the file.
+ * Every data packet but the last carries exactly packetDataSize bytes.
+ * Every field is in network byte order.
  */
 struct Syn
 {
-    uint32_t sequenceNumber; /**< Sequence number of the SYN packet. */
+    uint32_t sequenceNumber;  /**< Sequence number of the SYN packet. */
+    uint32_t packetDataSize;  /**< Number of data bytes in every data packet but the last. */
+    uint64_t transferSize;    /**< Number of bytes that will be sent, or 0 if not known in advance. */
+    uint32_t connectionId;    /**< Connection ID the sender puts in every data packet, never 0. */
+    uint32_t transferId;      /**< ID shared by the sub-flows of a striped transfer, or 0. */
+};
+
+/**
+ * @brief SACK block structure.
+ *
+ * This structure represents a range of packets that the receiver holds out of order,
+ * from start up to (but not including) end.
+ */
+struct SackBlock
+{
+    uint32_t start; /**< Sequence number of the first packet in the range. */
+    uint32_t end;   /**< Sequence number just after the last packet in the range. */
 };
 
 /**
  * @brief ACK packet structure.
  *
  * This structure represents the ACK packet used in the communication protocol.
- * It contains the acknowledgment number.
+ * It contains the acknowledgment number, the cumulative acknowledgment and the
+ * selective acknowledgment (SACK) blocks that tell the sender which packets after a
+ * missing packet have arrived. The first SACK block, if any, contains the packet that
+ * triggered the ACK. The window tells the sender how far past the cumulative
+ * acknowledgment it may send, so a receiver whose disk falls behind slows it down.
+ * Every field, including those of the SACK blocks, is in network byte order.
+ *
+ * In the 3-way handshake only the acknowledgment number is used.
  */
 struct Ack
 {
-    uint32_t ackNumber; /**< Acknowledgment number of the ACK packet. */
+    uint32_t ackNumber;                         /**< Acknowledgment number of the ACK packet. */
+    uint32_t cumulativeAck;                     /**< Every data packet before this sequence number has been received. */
+    uint32_t sackCount;                         /**< Number of SACK blocks in use. */
+    uint32_t window;                            /**< Number of packets from cumulativeAck on the receiver has room for. */
+    struct SackBlock sacks[MAX_SACK_BLOCKS];    /**< Ranges of packets received after a missing packet. */
 };
 
 /**
  * @brief SYN-ACK packet structure.
  *
  * This structure represents the SYN-ACK packet used in the three-way handshake process.
- * It contains both the sequence number and acknowledgment number.
+ * It contains both the sequence number and acknowledgment number, in network byte order.
  */
 struct SynAck
 {
@@ -128,4 +408,48 @@ struct SynAck
     uint32_t ackNumber;      /**< Acknowledgment number of the SYN-ACK packet. */
 };
 
+/**
+ * @brief Send state of a single data packet.
+ *
+ * The sender keeps one of these for every packet in its window. It holds the packet's
+ * header and a pointer to its data, so that the packet can be retransmitted without
+ * reading the file again, along with the bookkeeping needed to decide when to retransmit it.
+ * The data is in the memory-mapped file, or read into packet just after the header.
+ */
+struct PacketState
+{
+    uint32_t sequenceNumber;                      /**< Sequence number of the packet. */
+    int length;                                   /**< Number of bytes in the datagram. */
+    u_char acked;                                 /**< Flag indicating if the packet has been acknowledged. */
+    int retries;                                  /**< Number of times the packet has timed out. */
+    u_char lost;                                  /**< Flag indicating if the packet is waiting to be retransmitted. */
+    u_char fastRetransmitted;                     /**< Flag indicating if SACKs have already shown the packet to be lost. */
+    unsigned long long sentTime;                  /**< Time of the most recent transmission, in microseconds. */
+    unsigned long long firstSentTime;             /**< Send time of the first packet of the flight this packet was sent in. */
+    unsigned long long delivered;                 /**< Total bytes delivered when the packet was sent. */
+    unsigned long long deliveredTime;             /**< Time of the last delivery when the packet was sent. */
+    u_char appLimited;                            /**< Flag indicating if the sender was application-limited when the packet was sent. */
+    u_char lastPacket;                            /**< Flag indicating if this is the last packet of the file. */
+    const char *data;                             /**< The data of the packet. */
+    uint32_t zerocopyId;                          /**< ID of the latest MSG_ZEROCOPY send of the packet. */
+    u_char zerocopyPending;                       /**< Flag indicating if the packet has been sent with MSG_ZEROCOPY. */
+    char header[MAX_HEADER_SIZE];                 /**< The header of the packet. */
+    u_char headerLength;                          /**< Length of the header, including extensions. */
+};
+
+/**
+ * @brief A data packet held by the receiver until it can be written in order.
+ */
+struct BufferedPacket
+{
+    u_char received;                /**< Flag indicating if this entry holds a packet. */
+    struct Header header;           /**< Header of the packet. */
+    const char *payload;            /**< Data of the packet: data, or the io_uring receive buffer it arrived in. */
+    int bufferId;                   /**< ID of the io_uring receive buffer holding the data, or -1 if it is in data. */
+    u_char writing;                 /**< Flag indicating if the data is being written to the file through io_uring. */
+    unsigned long long writeOffset; /**< Offset in the file the data is written at. */
+    unsigned int written;           /**< Number of bytes of the data written so far. */
+    char data[MAX_BUFFER_SIZE];     /**< Data of the packet. */
+};
+
 #endif // UDP_H
@@ -0,0 +1,236 @@
+/** @file uring.h
+ *  @brief Structure and function definitions for the io_uring
+ *         submission and completion rings.
+ *
+ *  An io_uring is a pair of rings shared with the kernel. Requests
+ *  (sends, receives, file reads and writes) are placed on the submission
+ *  queue and handed to the kernel with a single io_uring_enter call, and
+ *  their results come back on the completion queue, where they can be
+ *  read without any system call. This is a minimal wrapper over the raw
+ *  system calls, so the programs do not depend on liburing.
+ *
+ *  @author Vicky Chen (chen-vv)
+ *  @author Eric Omielan (eomielan)
+ *  @bug No known bugs.
+ */
+
+#ifndef URING_H
+#define URING_H
+
+#include <stddef.h>          // For size_t
+#include <stdint.h>          // For uint64_t
+#include <sys/socket.h>      // For struct msghdr
+#include <linux/io_uring.h>  // For struct io_uring_sqe and struct io_uring_cqe
+
+/**
+ * @brief An io_uring instance, with its rings mapped into memory.
+ */
+struct Uring
+{
+    int fd;                           /**< The io_uring file descriptor. */
+    unsigned *sqHead;                 /**< Head of the submission queue, advanced by the kernel. */
+    unsigned *sqTail;                 /**< Tail of the submission queue, advanced by the program. */
+    unsigned sqMask;                  /**< Mask turning a submission queue position into an index. */
+    unsigned sqEntries;               /**< Number of entries in the submission queue. */
+    unsigned *sqArray;                /**< Indexes of the submission queue entries, in submission order. */
+    struct io_uring_sqe *sqes;        /**< The submission queue entries. */
+    unsigned sqeTail;                 /**< Position after the last entry handed out by uring_get_sqe. */
+    unsigned *cqHead;                 /**< Head of the completion queue, advanced by the program. */
+    unsigned *cqTail;                 /**< Tail of the completion queue, advanced by the kernel. */
+    unsigned cqMask;                  /**< Mask turning a completion queue position into an index. */
+    struct io_uring_cqe *cqes;        /**< The completion queue entries. */
+    void *ringMemory;                 /**< The mapping of both rings. */
+    size_t ringSize;                  /**< Size of the mapping of both rings. */
+    size_t sqesSize;                  /**< Size of the mapping of the submission queue entries. */
+    unsigned long long enterCalls;    /**< Number of io_uring_enter calls made. */
+};
+
+/**
+ * @brief A ring of buffers provided to the kernel for receives to pick from.
+ *
+ * A receive that selects a buffer from the ring takes the next free buffer
+ * only once data arrives, and its completion names the buffer it used. The
+ * buffer goes back to the ring once the program is done with it.
+ */
+struct UringBuffers
+{
+    struct io_uring_buf_ring *ring;   /**< The ring shared with the kernel. */
+    unsigned entries;                 /**< Number of buffers, a power of two. */
+    uint16_t tail;                    /**< Position after the last buffer given to the kernel. */
+    uint16_t groupId;                 /**< ID receives select the ring by. */
+    char *memory;                     /**< The buffers, one after another. */
+    size_t bufferSize;                /**< Size of each buffer, in bytes. */
+};
+
+/**
+ * @brief Sets up an io_uring.
+ *
+ * Fails if the kernel lacks io_uring or the features this wrapper relies on
+ * (a single mapping for both rings, requests that are stable once submitted,
+ * and waiting with a timeout), so the caller can fall back to plain system calls.
+ *
+ * @param ring The io_uring to set up
+ * @param entries The number of submission queue entries, a power of two
+ * @return 0 on success, or -1 with errno set on failure
+ */
+int uring_init(struct Uring *ring, unsigned entries);
+
+/**
+ * @brief Gets a cleared submission queue entry to fill in.
+ *
+ * If the submission queue is full, the entries in it are submitted first.
+ * The entry is handed to the kernel by the next uring_submit or uring_wait.
+ * Completions must be consumed often enough that the kernel has room for them.
+ *
+ * @param ring The io_uring
+ * @return The submission queue entry
+ */
+struct io_uring_sqe *uring_get_sqe(struct Uring *ring);
+
+/**
+ * @brief Fills in a submission queue entry that sends a message on a socket.
+ *
+ * The message (but not the data it points to) may be reused once it is submitted.
+ *
+ * @param sqe The submission queue entry
+ * @param fd The socket file descriptor
+ * @param message The message to send
+ * @param flags The flags to pass to sendmsg
+ * @param userData The value to give the completion
+ * @return Void
+ */
+void uring_prep_sendmsg(struct io_uring_sqe *sqe, int fd, const struct msghdr *message, int flags, uint64_t userData);
+
+/**
+ * @brief Fills in a submission queue entry that keeps receiving datagrams from a socket.
+ *
+ * Every datagram gives a completion with IORING_CQE_F_MORE set and the ID of the
+ * buffer it was received into. The receive ends (with a completion without
+ * IORING_CQE_F_MORE) if the buffer ring runs out of buffers, and must then be queued again.
+ *
+ * @param sqe The submission queue entry
+ * @param fd The socket file descriptor
+ * @param buffers The buffer ring to receive into
+ * @param userData The value to give the completions
+ * @return Void
+ */
+void uring_prep_recv_multishot(struct io_uring_sqe *sqe, int fd, const struct UringBuffers *buffers, uint64_t userData);
+
+/**
+ * @brief Fills in a submission queue entry that keeps receiving messages from a socket.
+ *
+ * Like uring_prep_recv_multishot, but each buffer starts with a struct
+ * io_uring_recvmsg_out, followed by room for an address and control data
+ * of the sizes given in message, and then the datagram.
+ *
+ * @param sqe The submission queue entry
+ * @param fd The socket file descriptor
+ * @param message Gives the room to leave for the address and the control data
+ * @param buffers The buffer ring to receive into
+ * @param userData The value to give the completions
+ * @return Void
+ */
+void uring_prep_recvmsg_multishot(struct io_uring_sqe *sqe, int fd, const struct msghdr *message,
+                                  const struct UringBuffers *buffers, uint64_t userData);
+
+/**
+ * @brief Fills in a submission queue entry that writes to a file at an offset.
+ *
+ * @param sqe The submission queue entry
+ * @param fd The file descriptor
+ * @param buffer The data to write, which must stay valid until the write completes
+ * @param length The number of bytes to write
+ * @param offset The offset in the file to write at
+ * @param userData The value to give the completion
+ * @return Void
+ */
+void uring_prep_write(struct io_uring_sqe *sqe, int fd, const void *buffer, unsigned length,
+                      unsigned long long offset, uint64_t userData);
+
+/**
+ * @brief Sets up a buffer ring and registers it with an io_uring.
+ *
+ * Every buffer starts out given to the kernel.
+ *
+ * @param ring The io_uring
+ * @param buffers The buffer ring to set up
+ * @param groupId The ID receives select the ring by
+ * @param entries The number of buffers, a power of two
+ * @param bufferSize The size of each buffer, in bytes
+ * @return 0 on success, or -1 with errno set on failure
+ */
+int uring_buffers_init(struct Uring *ring, struct UringBuffers *buffers, uint16_t groupId, unsigned entries,
+                       size_t bufferSize);
+
+/**
+ * @brief Gets a buffer of a buffer ring by its ID.
+ *
+ * @param buffers The buffer ring
+ * @param bufferId The ID of the buffer, from the completion that used it
+ * @return The buffer
+ */
+char *uring_buffer(const struct UringBuffers *buffers, uint16_t bufferId);
+
+/**
+ * @brief Gives a buffer back to the kernel once the program is done with it.
+ *
+ * @param buffers The buffer ring
+ * @param bufferId The ID of the buffer
+ * @return Void
+ */
+void uring_buffer_release(struct UringBuffers *buffers, uint16_t bufferId);
+
+/**
+ * @brief Unregisters and frees a buffer ring.
+ *
+ * @param ring The io_uring
+ * @param buffers The buffer ring
+ * @return Void
+ */
+void uring_buffers_exit(struct Uring *ring, struct UringBuffers *buffers);
+
+/**
+ * @brief Hands every filled submission queue entry to the kernel without waiting.
+ *
+ * @param ring The io_uring
+ * @return Void
+ */
+void uring_submit(struct Uring *ring);
+
+/**
+ * @brief Hands every filled submission queue entry to the kernel and waits for a completion.
+ *
+ * Both happen in a single io_uring_enter call. The wait ends once a completion
+ * is available, the timeout passes, or a signal arrives.
+ *
+ * @param ring The io_uring
+ * @param timeout The longest time to wait, in nanoseconds
+ * @return Void
+ */
+void uring_wait(struct Uring *ring, unsigned long long timeout);
+
+/**
+ * @brief Gets the oldest completion that has not been consumed.
+ *
+ * @param ring The io_uring
+ * @return The completion, or NULL if there is none
+ */
+struct io_uring_cqe *uring_peek(struct Uring *ring);
+
+/**
+ * @brief Consumes the completion returned by uring_peek.
+ *
+ * @param ring The io_uring
+ * @return Void
+ */
+void uring_advance(struct Uring *ring);
+
+/**
+ * @brief Tears down an io_uring, cancelling any requests still in progress.
+ *
+ * @param ring The io_uring
+ * @return Void
+ */
+void uring_exit(struct Uring *ring);
+
+#endif // URING_H
@@ -0,0 +1,92 @@
+/** @file writer.h
+ *  @brief Structure and function definitions for the receiver's
+ *         file writer thread.
+ *
+ *  The receiver hands the data of each packet to a dedicated thread
+ *  that writes it to the file, so a slow disk holds up the writer
+ *  thread instead of the receive loop. The two threads share a
+ *  lock-free single-producer/single-consumer ring of packet buffers.
+ *
+ *  @author Vicky Chen (chen-vv)
+ *  @author Eric Omielan (eomielan)
+ *  @bug No known bugs.
+ */
+
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <pthread.h> // For pthread_t
+
+#include "ring.h"
+#include "udp.h"
+
+/**
+ * @brief The data of one packet waiting to be written.
+ */
+struct WriteSlot
+{
+    unsigned long long offset;    /**< Offset in the file the data belongs at. */
+    unsigned int length;          /**< Number of bytes of data. */
+    char data[MAX_BUFFER_SIZE];   /**< The data. */
+};
+
+/**
+ * @brief A writer thread and the ring of packet buffers it writes from.
+ */
+struct Writer
+{
+    int fd;                 /**< The file being written. */
+    int seekable;           /**< Flag indicating if the file is written at offsets. */
+    struct Ring ring;       /**< The ring of struct WriteSlot buffers, filled by the receive loop. */
+    pthread_t thread;       /**< The writer thread. */
+};
+
+/**
+ * @brief Sets up the ring and starts the writer thread.
+ *
+ * @param writer The writer to start
+ * @param fd The file descriptor of the file to write
+ * @param seekable Flag indicating if the file can be written at any offset;
+ *                 otherwise data is written in the order it is handed over
+ * @param entries The number of slots in the ring, a power of two
+ * @return Void
+ */
+void writer_start(struct Writer *writer, int fd, int seekable, unsigned entries);
+
+/**
+ * @brief Gets the next free slot to fill with a packet's data.
+ *
+ * The slot is handed to the writer thread by writer_commit. If the ring is
+ * full, the slots filled so far are handed over, and the call sleeps until
+ * the writer thread frees a slot.
+ *
+ * @param writer The writer
+ * @return The slot
+ */
+struct WriteSlot *writer_reserve(struct Writer *writer);
+
+/**
+ * @brief Hands every slot filled since the last call to the writer thread.
+ *
+ * @param writer The writer
+ * @return Void
+ */
+void writer_commit(struct Writer *writer);
+
+/**
+ * @brief Returns the number of slots that can be reserved without waiting.
+ *
+ * @param writer The writer
+ * @return The number of free slots
+ */
+unsigned writer_space(struct Writer *writer);
+
+/**
+ * @brief Hands over the remaining slots, and waits for the writer thread to write them and exit.
+ *
+ * @param writer The writer
+ * @return Void
+ */
+void writer_finish(struct Writer *writer);
+
+#endif // WRITER_H
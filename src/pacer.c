@@ -0,0 +1,57 @@
+/** @file pacer.c
+ *  @brief Packet pacing for the UDP sender
+ *
+ *  This contains the pacer that spreads the sender's packets evenly at a
+ *  target rate. The rate comes from the congestion control algorithm, or
+ *  is fixed on the command line. The sender asks the pacer how long to
+ *  wait before each packet and waits for that long (or for an ACK) with a
+ *  high-resolution timeout.
+ *
+ *  @author Vicky Chen (chen-vv)
+ *  @author Eric Omielan (eomielan)
+ *  @bug No known bugs.
+ */
+
+/* -- Includes -- */
+
+#include <string.h>
+
+#include "include/pacer.h"
+
+void pacer_init(struct Pacer *pacer, unsigned int burst)
+{
+    memset(pacer, 0, sizeof(*pacer));
+    pacer->burst = burst;
+}
+
+void pacer_set_rate(struct Pacer *pacer, unsigned long long rate)
+{
+    pacer->rate = rate;
+}
+
+unsigned long long pacer_delay(const struct Pacer *pacer, unsigned long long now)
+{
+    if (pacer->rate == 0 || pacer->nextSendTime <= now)
+    {
+        return 0;
+    }
+
+    return pacer->nextSendTime - now;
+}
+
+void pacer_on_send(struct Pacer *pacer, unsigned long long now, unsigned int bytes)
+{
+    if (pacer->rate == 0)
+    {
+        return;
+    }
+
+    // Credit for time spent idle is capped at one burst
+    unsigned long long burstTime = (unsigned long long)pacer->burst * 1000000000ULL / pacer->rate;
+    if (pacer->nextSendTime + burstTime < now)
+    {
+        pacer->nextSendTime = now - burstTime;
+    }
+
+    pacer->nextSendTime += (unsigned long long)bytes * 1000000000ULL / pacer->rate;
+}
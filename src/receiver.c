@@ -14,37 +14,319 @@
 
 /* -- Includes -- */
 
+#define _GNU_SOURCE // For recvmmsg and sendmmsg
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <netinet/udp.h>
 #include <time.h>
+#include <endian.h>
 #include <fcntl.h>
 
+#include <limits.h>
+
+#include <linux/filter.h>
+
+#include <sys/epoll.h>
 #include <sys/time.h>
+#include <sys/timerfd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include <pthread.h>
 #include <errno.h>
+#include "include/bucket.h"
+#include "include/session.h"
 #include "include/udp.h"
+#include "include/uring.h"
+#include "include/writer.h"
 
 /* -- Global Variables -- */
 
 /**
- * @brief The most recent sequence number of a received packet.
+ * @brief ACKs waiting to be sent with the next sendmmsg call.
+ *
+ * This and the other ACK buffers down to _ackBatchCount are per thread, so
+ * each worker thread of the receiver daemon acknowledges packets without
+ * sharing anything with the others. The receive buffers are much larger, so
+ * they are allocated by the receiving thread instead, as a struct ReceiveBatch.
+ */
+__thread struct Ack _ackBatch[RECEIVE_BATCH_SIZE];
+
+/**
+ * @brief The sendmmsg messages for the ACKs in _ackBatch.
+ */
+__thread struct mmsghdr _ackMessages[RECEIVE_BATCH_SIZE];
+
+/**
+ * @brief The data of each ACK in _ackBatch.
+ */
+__thread struct iovec _ackData[RECEIVE_BATCH_SIZE];
+
+/**
+ * @brief The number of ACKs in _ackBatch.
+ */
+__thread int _ackBatchCount = 0;
+
+/**
+ * @brief Flag indicating if packets are received and written through io_uring (-U).
+ */
+int _useUring = FALSE;
+
+/**
+ * @brief The io_uring used when _useUring is set.
+ */
+struct Uring _uring;
+
+/**
+ * @brief The buffer ring datagrams are received into.
+ *
+ * Each buffer starts with a struct io_uring_recvmsg_out, the address and the
+ * control data, followed by the datagram.
+ */
+struct UringBuffers _uringReceive;
+
+/**
+ * @brief The message header giving the room for the address and the control data in each receive buffer.
+ */
+struct msghdr _uringReceiveMessage;
+
+/**
+ * @brief The number of references to each receive buffer.
+ *
+ * A buffer is referenced while its datagram is processed and by every write
+ * of a packet's data straight from it. It goes back to the kernel once
+ * nothing references it.
+ */
+int _uringBufferRefs[URING_RECEIVE_BUFFERS];
+
+/**
+ * @brief The number of receive buffers the kernel can pick from.
+ */
+int _uringFreeBuffers = 0;
+
+/**
+ * @brief Flag indicating if the multishot receive is in progress.
+ */
+int _uringReceiving = FALSE;
+
+/**
+ * @brief The number of writes to the file that have not completed.
+ */
+int _uringPendingWrites = 0;
+
+/**
+ * @brief ACKs being sent through io_uring, which must stay valid until their sends complete.
+ */
+struct Ack _uringAcks[URING_ACK_SLOTS];
+
+/**
+ * @brief The address each ACK in _uringAcks is sent to.
+ */
+struct sockaddr_in _uringAckAddresses[URING_ACK_SLOTS];
+
+/**
+ * @brief The data of each ACK in _uringAcks.
+ */
+struct iovec _uringAckData[URING_ACK_SLOTS];
+
+/**
+ * @brief The message of each ACK in _uringAcks.
+ */
+struct msghdr _uringAckMessages[URING_ACK_SLOTS];
+
+/**
+ * @brief The indexes of the entries of _uringAcks that are not being sent.
+ */
+int _uringFreeAckSlots[URING_ACK_SLOTS];
+
+/**
+ * @brief The number of indexes in _uringFreeAckSlots.
+ */
+int _uringFreeAckCount = 0;
+
+/**
+ * @brief Returns the current time in nanoseconds.
+ *
+ * The time is read from the monotonic clock so that it is not affected by
+ * changes to the system time while a transfer is in progress.
+ *
+ * @return The current time, in nanoseconds
+ */
+unsigned long long get_time_nsec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (unsigned long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief Checks whether a packet is waiting in the reorder buffer.
+ *
+ * @param session The session
+ * @param sequenceNumber The sequence number of the packet
+ * @return TRUE if the packet has been received but not yet written, FALSE otherwise
+ */
+int is_buffered(struct Session *session, uint32_t sequenceNumber)
+{
+    struct BufferedPacket *buffered = &session->reorderBuffer[sequenceNumber % REORDER_BUFFER_SIZE];
+
+    return buffered->received && buffered->header.sequenceNumber == sequenceNumber;
+}
+
+/**
+ * @brief Queues every ACK queued by send_packet_ack as an io_uring send.
+ *
+ * Each ACK is copied, along with its address, into a free entry of _uringAcks,
+ * so the receive buffer its address points into can be reused right away. The
+ * sends are submitted with the next uring_wait. If every entry is in use, the
+ * ACK is sent with a system call instead.
+ *
+ * @param sockfd The socket file descriptor
+ * @return Void
+ */
+void flush_acks_uring(int sockfd)
+{
+    for (int i = 0; i < _ackBatchCount; i++)
+    {
+        struct msghdr *batched = &_ackMessages[i].msg_hdr;
+
+        if (_uringFreeAckCount == 0)
+        {
+            if (sendmsg(sockfd, batched, 0) < 0 && errno != EINTR)
+            {
+                perror("sendmsg");
+                exit(EXIT_FAILURE);
+            }
+            continue;
+        }
+
+        int slot = _uringFreeAckSlots[--_uringFreeAckCount];
+        _uringAcks[slot] = _ackBatch[i];
+
+        socklen_t addrlen = batched->msg_namelen;
+        if (addrlen > sizeof(_uringAckAddresses[slot]))
+        {
+            addrlen = sizeof(_uringAckAddresses[slot]);
+        }
+        memcpy(&_uringAckAddresses[slot], batched->msg_name, addrlen);
+
+        _uringAckData[slot].iov_base = &_uringAcks[slot];
+        _uringAckData[slot].iov_len = _ackData[i].iov_len;
+
+        struct msghdr *message = &_uringAckMessages[slot];
+        memset(message, 0, sizeof(*message));
+        message->msg_name = &_uringAckAddresses[slot];
+        message->msg_namelen = addrlen;
+        message->msg_iov = &_uringAckData[slot];
+        message->msg_iovlen = 1;
+
+        uring_prep_sendmsg(uring_get_sqe(&_uring), sockfd, message, 0, ((uint64_t)URING_ACK << 32) | slot);
+    }
+
+    _ackBatchCount = 0;
+}
+
+/**
+ * @brief Sends every ACK queued by send_packet_ack.
+ *
+ * The ACKs go out with as few sendmmsg calls as possible, normally one.
+ * With io_uring, they are queued as sends by flush_acks_uring instead.
+ *
+ * @param sockfd The socket file descriptor
+ * @return Void
+ */
+void flush_acks(int sockfd)
+{
+    if (_useUring)
+    {
+        flush_acks_uring(sockfd);
+        return;
+    }
+
+    int sent = 0;
+
+    while (sent < _ackBatchCount)
+    {
+        int result = sendmmsg(sockfd, _ackMessages + sent, _ackBatchCount - sent, 0);
+        if (result < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            perror("sendmmsg");
+            exit(EXIT_FAILURE);
+        }
+
+        sent += result;
+    }
+
+    _ackBatchCount = 0;
+}
+
+/**
+ * @brief Returns the number of packets from the cumulative acknowledgment on the receiver has room for.
+ *
+ * This is the room in the reorder buffer, or in the writer thread's ring if that
+ * is smaller. Packets already in the ring beyond the cumulative acknowledgment
+ * are not counted back in, so the window errs on the small side. With a
+ * writeRate, the window is also no larger than the number of full packets
+ * the token bucket can pay for, so the sender slows down to writeRate.
  *
- * By default, this is set to 0. This is used to keep track of the
- * most recent sequence number received from the sender. This is
- * used to discard duplicate packets.
+ * @param session The session
+ * @return The window to advertise
  */
-uint32_t _latestSequenceNumber = 0;
+uint32_t get_receive_window(struct Session *session)
+{
+    uint32_t window = REORDER_BUFFER_SIZE;
+
+    if (!_useUring && session->writer.ring.slots != NULL)
+    {
+        unsigned space = writer_space(&session->writer);
+        if (space < window)
+        {
+            window = space;
+        }
+    }
+
+    if (session->writeBucket.rate > 0)
+    {
+        bucket_refill(&session->writeBucket, get_time_nsec());
+
+        long long packetDataSize = session->packetDataSize > 0 ? session->packetDataSize : MAX_BUFFER_SIZE;
+        long long affordable = session->writeBucket.tokens > 0 ? session->writeBucket.tokens / packetDataSize : 0;
+        if (affordable < window)
+        {
+            window = affordable;
+        }
+    }
+
+    return window;
+}
 
 /**
  * @brief Sends an acknowledgment message to the sender.
- * 
+ *
+ * Besides the sequence number of the packet being acknowledged, the ACK
+ * carries the cumulative acknowledgment (the next packet to be written), the
+ * window the receiver has room for, and up to MAX_SACK_BLOCKS ranges of
+ * packets waiting in the reorder buffer. The range containing the acknowledged
+ * packet is reported first, so that the newest information reaches the sender
+ * even when there are more ranges than fit in one ACK.
+ *
+ * The ACK is queued and sent together with the other ACKs of the batch by
+ * flush_acks, which the caller must call once the batch has been processed.
+ * The address must stay valid until then.
+ *
+ * @param session The session the packet belongs to
  * @param sockfd The socket file descriptor
  * @param addr The address of the sender
  * @param addrlen The length of the address
@@ -54,20 +336,123 @@ uint32_t _latestSequenceNumber = 0;
  * Sources:
  * https://www.ibm.com/docs/en/zos/3.1.0?topic=functions-sendto-send-data-socket
  */
-void send_packet_ack(int sockfd, struct sockaddr_in *addr, socklen_t addrlen, uint32_t sequenceNumber)
+void send_packet_ack(struct Session *session, int sockfd, struct sockaddr_in *addr, socklen_t addrlen,
+                     uint32_t sequenceNumber)
+{
+    if (_ackBatchCount == RECEIVE_BATCH_SIZE)
+    {
+        flush_acks(sockfd);
+    }
+
+    struct Ack ack;
+    ack.ackNumber = sequenceNumber;
+    ack.cumulativeAck = session->latestSequenceNumber + 1;
+    ack.sackCount = 0;
+    ack.window = get_receive_window(session);
+    session->advertisedWindow = ack.window;
+
+    // The packet after latestSequenceNumber is missing, otherwise it would have been written
+    uint32_t seq = session->latestSequenceNumber + 2;
+    uint32_t end = session->latestSequenceNumber + 1 + REORDER_BUFFER_SIZE;
+
+    while (seq != end && ack.sackCount < MAX_SACK_BLOCKS)
+    {
+        if (!is_buffered(session, seq))
+        {
+            seq++;
+            continue;
+        }
+
+        struct SackBlock *block = &ack.sacks[ack.sackCount++];
+        block->start = seq;
+        while (seq != end && is_buffered(session, seq))
+        {
+            seq++;
+        }
+        block->end = seq;
+
+        // Report the range containing the acknowledged packet first
+        if (!SEQ_LT(sequenceNumber, block->start) && SEQ_LT(sequenceNumber, block->end) && ack.sackCount > 1)
+        {
+            struct SackBlock first = ack.sacks[0];
+            ack.sacks[0] = *block;
+            *block = first;
+        }
+    }
+
+    struct iovec *data = &_ackData[_ackBatchCount];
+    data->iov_base = &_ackBatch[_ackBatchCount];
+    data->iov_len = ACK_HEADER_SIZE + ack.sackCount * sizeof(struct SackBlock);
+
+    for (uint32_t i = 0; i < ack.sackCount; i++)
+    {
+        ack.sacks[i].start = htonl(ack.sacks[i].start);
+        ack.sacks[i].end = htonl(ack.sacks[i].end);
+    }
+    ack.ackNumber = htonl(ack.ackNumber);
+    ack.cumulativeAck = htonl(ack.cumulativeAck);
+    ack.sackCount = htonl(ack.sackCount);
+    ack.window = htonl(ack.window);
+
+    _ackBatch[_ackBatchCount] = ack;
+
+    struct mmsghdr *message = &_ackMessages[_ackBatchCount];
+    memset(message, 0, sizeof(*message));
+    message->msg_hdr.msg_name = addr;
+    message->msg_hdr.msg_namelen = addrlen;
+    message->msg_hdr.msg_iov = data;
+    message->msg_hdr.msg_iovlen = 1;
+
+    _ackBatchCount++;
+}
+
+/**
+ * @brief Tells the sender that the window has reopened, if the last ACK closed it.
+ *
+ * The update is an ACK for the newest packet written, so the sender only
+ * takes the new window from it. It is queued like any other ACK.
+ *
+ * @param session The session
+ * @param sockfd The socket file descriptor
+ * @return Void
+ */
+void send_window_update(struct Session *session, int sockfd)
 {
-    if (sendto(sockfd, &sequenceNumber, sizeof(uint32_t), 0, (struct sockaddr *)addr, addrlen) == -1)
+    if (session->advertisedWindow == 0 && get_receive_window(session) > 0)
     {
-        perror("sendto");
-        exit(EXIT_FAILURE);
+        send_packet_ack(session, sockfd, &session->address, session->addressLength, session->latestSequenceNumber);
     }
 }
 
+/**
+ * @brief Sets up a session from what the sender's SYN announced.
+ *
+ * @param session The session
+ * @param syn The SYN
+ * @return Void
+ */
+void accept_syn(struct Session *session, struct Syn *syn)
+{
+    session->connectionId = ntohl(syn->connectionId);
+    session->transferId = ntohl(syn->transferId);
+    session->firstSequenceNumber = ntohl(syn->sequenceNumber);
+
+    // A packet data size the receiver cannot hold means it does not know where packets go
+    uint32_t packetDataSize = ntohl(syn->packetDataSize);
+    session->packetDataSize = packetDataSize <= MAX_BUFFER_SIZE ? packetDataSize : 0;
+    session->transferSize = be64toh(syn->transferSize);
+
+    // The sender's first data packet carries the SYN's sequence number
+    session->latestSequenceNumber = session->firstSequenceNumber - 1;
+}
+
 /**
  * @brief Establishes a connection with the sender using the 3-way handshake process.
  *
  * Receives a SYN packet from the sender and sends a SYN-ACK packet back. Upon receiving
- * the final ACK packet, the connection is established.
+ * the final ACK packet, the connection is established. If the final ACK packet is lost,
+ * the first data packet from the sender also establishes the connection; that data
+ * packet is discarded and will be retransmitted by the sender.
  *
  * This function sets a random value for the sequence number that will be sent to the
  * sender. This is used to ensure that the sender and receiver are in sync with each other
@@ -79,13 +464,17 @@ void send_packet_ack(int sockfd, struct sockaddr_in *addr, socklen_t addrlen, ui
  * this function will initiate an exponential backoff mechanism and double the timeout until a
  * maximum timeout is reached.
  *
+ * What the SYN announces is kept in the session, along with the address of the sender.
+ *
+ * @param session The session
  * @param sockfd The socket file descriptor
- * @param addr The address of the sender
- * @param addrlen The length of the address
  * @return Void
  */
-void establish_connection(int sockfd, struct sockaddr_in *addr, socklen_t addrlen)
+void establish_connection(struct Session *session, int sockfd)
 {
+    struct sockaddr_in *addr = &session->address;
+    socklen_t addrlen = sizeof(session->address);
+
     struct timeval tv;
     int timeout = SYN_ACK_DEFAULT_TIMEOUT_MILLISEC;
     tv.tv_sec = 0;
@@ -103,16 +492,21 @@ void establish_connection(int sockfd, struct sockaddr_in *addr, socklen_t addrle
 
         // Listen for SYN packet
         struct Syn syn;
+        memset(&syn, 0, sizeof(syn));
         ssize_t bytes_received = recvfrom(sockfd, &syn, sizeof(struct Syn), 0, (struct sockaddr *)addr, &addrlen);
 
         if (bytes_received > 0)
         {
+            session->addressLength = addrlen;
+            accept_syn(session, &syn);
+
             struct SynAck syn_ack;
 
             // Initialize sequence number and ack number
             srand(time(NULL));
-            syn_ack.sequenceNumber = rand();
-            syn_ack.ackNumber = syn.sequenceNumber + 1;
+            uint32_t synAckSequenceNumber = rand();
+            syn_ack.sequenceNumber = htonl(synAckSequenceNumber);
+            syn_ack.ackNumber = htonl(session->firstSequenceNumber + 1);
 
             timeout = SYN_ACK_DEFAULT_TIMEOUT_MILLISEC;
             tv.tv_usec = timeout;
@@ -122,20 +516,26 @@ void establish_connection(int sockfd, struct sockaddr_in *addr, socklen_t addrle
                 // Send SYN-ACK packet
                 sendto(sockfd, &syn_ack, sizeof(struct SynAck), 0, (struct sockaddr *)addr, addrlen);
 
-                // Listen for ACK packet
-                struct Ack ack;
-                ssize_t recv_size = recvfrom(sockfd, &ack, sizeof(struct Ack), 0, (struct sockaddr *)addr, &addrlen);
+                // Listen for ACK packet. The buffer is large enough to hold a data packet instead.
+                char response[MAX_PACKET_SIZE];
+                ssize_t recv_size = recvfrom(sockfd, response, sizeof(response), 0, (struct sockaddr *)addr, &addrlen);
 
-                if (recv_size > 0)
+                struct Header header;
+                if (recv_size >= ACK_HEADER_SIZE)
                 {
-                    if (ack.ackNumber == syn_ack.ackNumber)
+                    struct Ack ack;
+                    memcpy(&ack, response, ACK_HEADER_SIZE);
+
+                    if (ntohl(ack.ackNumber) == synAckSequenceNumber + 1)
                     {
                         return;
                     }
-                    else
-                    {
-                        continue;
-                    }
+                }
+
+                if (recv_size >= 0 && header_decode(&header, response, recv_size) >= 0)
+                {
+                    // Data packet, so the sender has already received the SYN-ACK
+                    return;
                 }
                 else if (recv_size == -1)
                 {
@@ -179,127 +579,1353 @@ void establish_connection(int sockfd, struct sockaddr_in *addr, socklen_t addrle
     }
 }
 
-/** @brief Writes the bytes received on port myUDPport to a file
- *         called destinationFile at a rate of writeRate bytes
- *         per second.
+/**
+ * @brief Asks the kernel to coalesce consecutive datagrams of a flow (UDP GRO).
  *
- *  If writeRate is 0, then the receiver can write as many bytes
- *  as possible into destinationFile. Otherwise, if writeRate is
- *  non-zero then the receiver writes no more than writeRate bytes
- *  per second to destinationFile. See rsend for the counterpart function.
+ * A coalesced datagram is read in one go, with its segment size in a UDP_GRO
+ * control message. If the kernel does not support UDP GRO, every datagram is
+ * read on its own as before.
  *
- *  @param myUDPport The port number to listen on.
- *  @param destinationFile The name of the file to write to.
- *  @param writeRate The maximum number of bytes to write per second.
- *                   Must be an integer greater than or equal to zero.
- *  @return Void.
+ * @param sockfd The socket file descriptor
+ * @return Void
+ */
+void enable_gro(int sockfd)
+{
+    int enable = 1;
+    setsockopt(sockfd, SOL_UDP, UDP_GRO, &enable, sizeof(enable));
+}
+
+/**
+ * @brief Returns the length of each packet in a datagram that may have been coalesced by UDP GRO.
  *
- *  Sources:
- *  https://www.geeksforgeeks.org/socket-programming-cc/
- *  https://www.gta.ufrj.br/ensino/eel878/sockets/sockaddr_inman.html
- *  https://www.geeksforgeeks.org/time-function-in-c/
- *  https://www.ibm.com/docs/en/zos/3.1.0?topic=functions-recvfrom-receive-messages-socket
+ * Every packet of a coalesced datagram but the last has the segment size.
+ *
+ * @param message The message header the datagram was received with
+ * @param length The length of the datagram
+ * @return The segment size, or the length of the datagram if it was not coalesced
  */
-void rrecv(unsigned short int myUDPport,
-           char *destinationFile,
-           unsigned long long int writeRate)
+int get_segment_size(struct msghdr *message, int length)
 {
-    // Initialize socket
-    int sockfd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-    if (sockfd < 0)
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(message); cmsg != NULL; cmsg = CMSG_NXTHDR(message, cmsg))
     {
-        perror("socket");
-        exit(1);
+        if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO)
+        {
+            int segmentSize;
+            memcpy(&segmentSize, CMSG_DATA(cmsg), sizeof(segmentSize));
+            if (segmentSize > 0)
+            {
+                return segmentSize;
+            }
+        }
     }
 
-    struct sockaddr_in addr;
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(myUDPport);
-    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    return length;
+}
 
-    socklen_t addrlen = sizeof(addr);
+/**
+ * @brief Prepares a message header to receive a datagram into one of the receive buffers.
+ *
+ * @param batch The receive buffers
+ * @param message The message header to prepare
+ * @param data The I/O vector to use for the buffer
+ * @param index The index of the receive buffer
+ * @return Void
+ */
+void prepare_receive(struct ReceiveBatch *batch, struct msghdr *message, struct iovec *data, int index)
+{
+    data->iov_base = batch->buffers[index];
+    data->iov_len = GRO_BUFFER_SIZE;
 
-    int err = bind(sockfd, (struct sockaddr *)&addr, addrlen);
-    if (err < 0)
-    {
-        perror("bind");
-        exit(1);
-    }
+    memset(message, 0, sizeof(*message));
+    message->msg_name = &batch->addresses[index];
+    message->msg_namelen = sizeof(batch->addresses[index]);
+    message->msg_iov = data;
+    message->msg_iovlen = 1;
+    message->msg_control = batch->controls[index].buffer;
+    message->msg_controllen = sizeof(batch->controls[index].buffer);
+}
 
-    // Prepare file for writing
-    FILE *file = fopen(destinationFile, "wb");
-    if (file == NULL)
+/**
+ * @brief Allocates the buffers a thread receives batches of datagrams into.
+ *
+ * @return The receive buffers, to be freed by the caller
+ */
+struct ReceiveBatch *alloc_receive_batch()
+{
+    struct ReceiveBatch *batch = malloc(sizeof(struct ReceiveBatch));
+    if (batch == NULL)
     {
-        perror("fopen");
+        perror("malloc");
         exit(1);
     }
 
-    // Establish connection with sender prior to receiving packets
-    establish_connection(sockfd, &addr, addrlen);
+    return batch;
+}
 
-    time_t start, end;
-    time(&start);
+/**
+ * @brief Keeps acknowledging retransmitted packets after the whole file has been written.
+ *
+ * If the ACK for one of the final packets is lost, the sender retransmits that packet and
+ * would eventually give up if the receiver had already exited. This function re-acknowledges
+ * any packet that arrives, and returns once no packet has arrived for LINGER_TIMEOUT.
+ *
+ * @param session The session
+ * @param sockfd The socket file descriptor
+ * @param batch The receive buffers
+ * @return Void
+ */
+void linger(struct Session *session, int sockfd, struct ReceiveBatch *batch)
+{
+    struct timeval tv;
+    tv.tv_sec = LINGER_TIMEOUT / 1000000;
+    tv.tv_usec = LINGER_TIMEOUT % 1000000;
+
+    if (setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0)
+    {
+        perror("timeout");
+        exit(1);
+    }
+
+    struct msghdr message;
+    struct iovec data;
+    ssize_t bytesReceived;
+
+    prepare_receive(batch, &message, &data, 0);
+    while ((bytesReceived = recvmsg(sockfd, &message, 0)) >= 0)
+    {
+        int segmentSize = get_segment_size(&message, bytesReceived);
+
+        for (int offset = 0; offset < bytesReceived; offset += segmentSize)
+        {
+            int packetLength = bytesReceived - offset < segmentSize ? bytesReceived - offset : segmentSize;
+
+            struct Header header;
+            if (header_decode(&header, batch->buffers[0] + offset, packetLength) >= 0)
+            {
+                send_packet_ack(session, sockfd, &batch->addresses[0], message.msg_namelen, header.sequenceNumber);
+            }
+        }
+        flush_acks(sockfd);
+
+        prepare_receive(batch, &message, &data, 0);
+    }
+}
+
+/**
+ * @brief Queues an io_uring write of the rest of a packet's data to the file.
+ *
+ * @param session The session
+ * @param buffered The reorder buffer entry of the packet
+ * @return Void
+ */
+void submit_write(struct Session *session, struct BufferedPacket *buffered)
+{
+    uring_prep_write(uring_get_sqe(&_uring), session->fd, buffered->payload + buffered->written,
+                     buffered->header.messageLength - buffered->written, buffered->writeOffset + buffered->written,
+                     ((uint64_t)URING_WRITE << 32) | (buffered - session->reorderBuffer));
+}
+
+/**
+ * @brief Writes the data of a packet to the file.
+ *
+ * The data is copied into the writer thread's ring, and handed over to it
+ * with the rest of the batch by writer_commit. With io_uring, the write is
+ * queued as a request instead, and the reorder buffer entry stays in use
+ * until it completes. Either way, the data is paid for from the token bucket.
+ *
+ * @param session The session
+ * @param buffered The reorder buffer entry of the packet
+ * @param offset The offset in the file the data belongs at
+ * @return Void
+ */
+void write_packet(struct Session *session, struct BufferedPacket *buffered, unsigned long long offset)
+{
+    bucket_consume(&session->writeBucket, buffered->header.messageLength);
+
+    if (!_useUring)
+    {
+        struct WriteSlot *slot = writer_reserve(&session->writer);
+        slot->offset = offset;
+        slot->length = buffered->header.messageLength;
+        memcpy(slot->data, buffered->payload, slot->length);
+        return;
+    }
+
+    buffered->writing = TRUE;
+    buffered->writeOffset = offset;
+    buffered->written = 0;
+    _uringPendingWrites++;
+
+    submit_write(session, buffered);
+}
+
+/**
+ * @brief Drops a reference to an io_uring receive buffer, giving it back to the kernel if it was the last.
+ *
+ * @param bufferId The ID of the receive buffer
+ * @return Void
+ */
+void release_buffer(int bufferId)
+{
+    if (--_uringBufferRefs[bufferId] == 0)
+    {
+        uring_buffer_release(&_uringReceive, bufferId);
+        _uringFreeBuffers++;
+    }
+}
+
+/**
+ * @brief Processes one data packet from the sender.
+ *
+ * Duplicates are acknowledged again and discarded. New packets are placed in
+ * the reorder buffer and acknowledged, then every packet that is now in order
+ * is written to the file.
+ *
+ * When the SYN announced the packet data size, every new packet is written
+ * to the file straight away, at the offset given by its sequence number, and
+ * the reorder buffer only keeps track of which packets have arrived.
+ * Otherwise, a packet received into an io_uring buffer that is next in order
+ * is written straight from that buffer, and packets that arrive ahead of a
+ * missing one are copied into the reorder buffer, so they never keep a
+ * receive buffer from the kernel while the missing packet is awaited.
+ *
+ * @param session The session the packet belongs to
+ * @param sockfd The socket file descriptor
+ * @param packet The packet (header followed by data)
+ * @param length The length of the packet
+ * @param addr The address of the sender
+ * @param addrlen The length of the address
+ * @param bufferId The ID of the io_uring receive buffer holding the packet, or -1
+ * @return TRUE if the last packet of the file has been written, FALSE otherwise
+ */
+int handle_packet(struct Session *session, int sockfd, char *packet, int length, struct sockaddr_in *addr,
+                  socklen_t addrlen, int bufferId)
+{
+    // Stray handshake packets and packets of another protocol version are invalid
+    struct Header header;
+    int headerLength = header_decode(&header, packet, length);
+    if (headerLength < 0)
+    {
+        return FALSE;
+    }
+
+    // If packet's sequence number has already been received, discard duplicate.
+    // It is acknowledged again in case the previous ACK was lost.
+    if (SEQ_LEQ(header.sequenceNumber, session->latestSequenceNumber))
+    {
+        send_packet_ack(session, sockfd, addr, addrlen, header.sequenceNumber);
+        return FALSE;
+    }
+
+    // If there is no room to buffer the packet, discard it without acknowledging it
+    // so that the sender retransmits it once the packets before it have been written
+    if (!SEQ_LEQ(header.sequenceNumber, session->latestSequenceNumber + REORDER_BUFFER_SIZE))
+    {
+        return FALSE;
+    }
+
+    // A sub-flow of a striped transfer sends pieces from all over the file, so each packet says where it goes
+    unsigned long long offset = 0;
+    if (session->transferId != 0)
+    {
+        uint8_t offsetLength;
+        const void *value = header_find_extension(packet, HEADER_EXTENSION_OFFSET, &offsetLength);
+        if (value == NULL || offsetLength != sizeof(uint64_t))
+        {
+            return FALSE;
+        }
+
+        uint64_t position;
+        memcpy(&position, value, sizeof(position));
+        offset = be64toh(position);
+    }
+
+    // The entry is still taken by a packet whose data is being written, so treat this one as lost too
+    struct BufferedPacket *buffered = &session->reorderBuffer[header.sequenceNumber % REORDER_BUFFER_SIZE];
+    if (buffered->writing)
+    {
+        return FALSE;
+    }
+
+    if (!buffered->received)
+    {
+        buffered->header = header;
+        if (session->positionalWrites)
+        {
+            buffered->payload = packet + headerLength;
+            buffered->bufferId = bufferId;
+            if (bufferId >= 0)
+            {
+                _uringBufferRefs[bufferId]++;
+            }
+
+            // Otherwise every packet before this one is full, so its sequence number says where it goes
+            if (session->transferId == 0)
+            {
+                uint32_t index = header.sequenceNumber - session->firstSequenceNumber;
+                offset = (unsigned long long)index * session->packetDataSize;
+            }
+            write_packet(session, buffered, offset);
+        }
+        else if (bufferId >= 0 && header.sequenceNumber == session->latestSequenceNumber + 1)
+        {
+            buffered->payload = packet + headerLength;
+            buffered->bufferId = bufferId;
+            _uringBufferRefs[bufferId]++;
+        }
+        else
+        {
+            memcpy(buffered->data, packet + headerLength, header.messageLength);
+            buffered->payload = buffered->data;
+            buffered->bufferId = -1;
+        }
+        buffered->received = TRUE;
+    }
+
+    send_packet_ack(session, sockfd, addr, addrlen, header.sequenceNumber);
+
+    // Move past every packet that is now in order, writing it unless it was written when it arrived
+    while (TRUE)
+    {
+        buffered = &session->reorderBuffer[(session->latestSequenceNumber + 1) % REORDER_BUFFER_SIZE];
+        if (!buffered->received)
+        {
+            return FALSE;
+        }
+
+        if (!session->positionalWrites)
+        {
+            write_packet(session, buffered, session->bytesWritten);
+        }
+
+        buffered->received = FALSE;
+        session->bytesWritten += buffered->header.messageLength;
+        session->latestSequenceNumber++;
+
+        if (buffered->header.lastPacket)
+        {
+            return TRUE;
+        }
+    }
+}
+
+/**
+ * @brief Reserves disk space for the whole transfer, if the sender announced its size.
+ *
+ * Allocating the file in one go lets the file system lay it out in a few large
+ * extents, even though packets are written in the order they arrive. The size
+ * of the file is left alone, so it only grows as data is written. File systems
+ * that cannot preallocate are written as before.
+ *
+ * @param session The session
+ * @return Void
+ */
+void preallocate(struct Session *session)
+{
+    if (!session->seekable || session->transferSize == 0)
+    {
+        return;
+    }
+
+    if (fallocate(session->fd, FALLOC_FL_KEEP_SIZE, 0, session->transferSize) < 0 && errno != EOPNOTSUPP && errno != ENOSYS)
+    {
+        perror("fallocate");
+        exit(1);
+    }
+}
+
+/**
+ * @brief Queues the multishot receive of data packets into the io_uring buffer ring.
+ *
+ * @param sockfd The socket file descriptor
+ * @return Void
+ */
+void post_receive(int sockfd)
+{
+    uring_prep_recvmsg_multishot(uring_get_sqe(&_uring), sockfd, &_uringReceiveMessage, &_uringReceive,
+                                 (uint64_t)URING_RECEIVE << 32);
+    _uringReceiving = TRUE;
+}
+
+/**
+ * @brief Sets up the io_uring engine, if it was asked for.
+ *
+ * If the kernel has no usable io_uring, or no buffer rings, or the file
+ * is not a regular file, the receiver makes system calls instead.
+ *
+ * @param session The session
+ * @param sockfd The socket file descriptor
+ * @return Void
+ */
+void start_uring(struct Session *session, int sockfd)
+{
+    if (!_useUring)
+    {
+        return;
+    }
+
+    // Queued writes may complete in any order, so they need a file that is written at offsets
+    if (!session->seekable)
+    {
+        fprintf(stderr, "io_uring needs a regular file to write to, using system calls\n");
+        _useUring = FALSE;
+        return;
+    }
+
+    if (uring_init(&_uring, URING_ENTRIES) < 0)
+    {
+        fprintf(stderr, "io_uring not available (%s), using system calls\n", strerror(errno));
+        _useUring = FALSE;
+        return;
+    }
+
+    memset(&_uringReceiveMessage, 0, sizeof(_uringReceiveMessage));
+    _uringReceiveMessage.msg_namelen = sizeof(struct sockaddr_in);
+    _uringReceiveMessage.msg_controllen = CMSG_SPACE(sizeof(int));
+
+    size_t headroom = sizeof(struct io_uring_recvmsg_out) + _uringReceiveMessage.msg_namelen +
+                      _uringReceiveMessage.msg_controllen;
+
+    if (uring_buffers_init(&_uring, &_uringReceive, 0, URING_RECEIVE_BUFFERS, headroom + GRO_BUFFER_SIZE) < 0)
+    {
+        fprintf(stderr, "io_uring buffer rings not available (%s), using system calls\n", strerror(errno));
+        uring_exit(&_uring);
+        _useUring = FALSE;
+        return;
+    }
+    _uringFreeBuffers = URING_RECEIVE_BUFFERS;
+
+    for (int i = 0; i < URING_ACK_SLOTS; i++)
+    {
+        _uringFreeAckSlots[i] = i;
+    }
+    _uringFreeAckCount = URING_ACK_SLOTS;
+
+    post_receive(sockfd);
+}
+
+/**
+ * @brief Processes a datagram received into an io_uring buffer.
+ *
+ * The buffer starts with a struct io_uring_recvmsg_out describing the
+ * address, the control data and the datagram that follow it.
+ *
+ * @param session The session
+ * @param sockfd The socket file descriptor
+ * @param bufferId The ID of the receive buffer
+ * @return TRUE if the last packet of the file has been written, FALSE otherwise
+ */
+int handle_datagram_uring(struct Session *session, int sockfd, int bufferId)
+{
+    char *buffer = uring_buffer(&_uringReceive, bufferId);
+    struct io_uring_recvmsg_out *out = (struct io_uring_recvmsg_out *)buffer;
+
+    struct sockaddr_in *addr = (struct sockaddr_in *)(buffer + sizeof(*out));
+    char *control = (char *)addr + _uringReceiveMessage.msg_namelen;
+    char *datagram = control + _uringReceiveMessage.msg_controllen;
+
+    // Only the control data is needed to find the GRO segment size
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_control = control;
+    message.msg_controllen = out->controllen;
+
+    // A truncated datagram reports its full length, but only what fit was received
+    int length = out->payloadlen;
+    if (length > GRO_BUFFER_SIZE)
+    {
+        length = GRO_BUFFER_SIZE;
+    }
+
+    int segmentSize = get_segment_size(&message, length);
+    int lastPacketWritten = FALSE;
+
+    for (int offset = 0; offset < length; offset += segmentSize)
+    {
+        int packetLength = length - offset < segmentSize ? length - offset : segmentSize;
+
+        lastPacketWritten |= handle_packet(session, sockfd, datagram + offset, packetLength, addr, out->namelen,
+                                           bufferId);
+    }
+
+    return lastPacketWritten;
+}
+
+/**
+ * @brief Consumes every io_uring completion that has arrived.
+ *
+ * Each received datagram is processed and its ACKs queued before its buffer
+ * is released. A completed write releases the buffer it was made from, and a
+ * completed ACK send frees its entry of _uringAcks.
+ *
+ * @param session The session
+ * @param sockfd The socket file descriptor
+ * @return TRUE if the last packet of the file has been written, FALSE otherwise
+ */
+int reap_uring(struct Session *session, int sockfd)
+{
+    struct io_uring_cqe *cqe;
+    int lastPacketWritten = FALSE;
+
+    while ((cqe = uring_peek(&_uring)) != NULL)
+    {
+        uint64_t userData = cqe->user_data;
+        int result = cqe->res;
+        unsigned flags = cqe->flags;
+        uring_advance(&_uring);
+
+        unsigned index = userData & 0xFFFFFFFF;
+
+        switch (userData >> 32)
+        {
+        case URING_RECEIVE:
+            if (flags & IORING_CQE_F_BUFFER)
+            {
+                int bufferId = flags >> IORING_CQE_BUFFER_SHIFT;
+                _uringFreeBuffers--;
+                _uringBufferRefs[bufferId] = 1;
+
+                if (result >= 0)
+                {
+                    lastPacketWritten |= handle_datagram_uring(session, sockfd, bufferId);
+                }
+                flush_acks(sockfd);
+                release_buffer(bufferId);
+            }
+
+            // The receive ends when it runs out of buffers, and is queued again once some are released
+            if (!(flags & IORING_CQE_F_MORE))
+            {
+                _uringReceiving = FALSE;
+
+                if (result < 0 && result != -ENOBUFS && result != -EINTR && result != -EAGAIN && result != -ECANCELED)
+                {
+                    fprintf(stderr, "recvmsg: %s\n", strerror(-result));
+                    exit(1);
+                }
+            }
+            break;
+
+        case URING_WRITE:
+        {
+            struct BufferedPacket *buffered = &session->reorderBuffer[index];
+            if (result <= 0 && buffered->written < buffered->header.messageLength)
+            {
+                fprintf(stderr, "write: %s\n", result < 0 ? strerror(-result) : "no progress");
+                exit(1);
+            }
+
+            buffered->written += result;
+            if (buffered->written < buffered->header.messageLength)
+            {
+                submit_write(session, buffered);
+                break;
+            }
+
+            buffered->writing = FALSE;
+            _uringPendingWrites--;
+            if (buffered->bufferId >= 0)
+            {
+                release_buffer(buffered->bufferId);
+            }
+            break;
+        }
+
+        case URING_ACK:
+            // A lost ACK is covered by the next one
+            _uringFreeAckSlots[_uringFreeAckCount++] = index;
+            break;
+        }
+    }
+
+    return lastPacketWritten;
+}
+
+/**
+ * @brief Receives and writes the file through io_uring until the last packet has been written.
+ *
+ * Datagrams arrive through a multishot receive into a registered buffer ring,
+ * data is written to the file straight from those buffers, and ACKs
+ * go out as io_uring sends. Everything queued is submitted with the single
+ * io_uring_enter call that waits for the next completion, or for
+ * WINDOW_UPDATE_INTERVAL to check whether the window has reopened.
+ *
+ * @param session The session
+ * @param sockfd The socket file descriptor
+ * @return Void
+ */
+void receive_uring(struct Session *session, int sockfd)
+{
+    int lastPacketWritten = FALSE;
+
+    // The file is only complete once every queued write has finished
+    while (!lastPacketWritten || _uringPendingWrites > 0)
+    {
+        if (!_uringReceiving && _uringFreeBuffers > 0)
+        {
+            post_receive(sockfd);
+        }
+
+        uring_wait(&_uring, WINDOW_UPDATE_INTERVAL * 1000ULL);
+        lastPacketWritten |= reap_uring(session, sockfd);
+
+        if (!lastPacketWritten)
+        {
+            send_window_update(session, sockfd);
+            flush_acks(sockfd);
+        }
+    }
+
+    uring_buffers_exit(&_uring, &_uringReceive);
+    uring_exit(&_uring);
+    _useUring = FALSE;
+}
+
+/**
+ * @brief Opens the file a session writes to.
+ *
+ * @param session The session
+ * @param filename The name of the file
+ * @param truncate Flag indicating if the file is emptied if it exists
+ * @return 0 on success, or -1 if the file cannot be opened
+ */
+int open_output(struct Session *session, char *filename, int truncate)
+{
+    session->fd = open(filename, O_WRONLY | O_CREAT | (truncate ? O_TRUNC : 0), 0666);
+    if (session->fd < 0)
+    {
+        perror("open");
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(session->fd, &st) < 0)
+    {
+        perror("fstat");
+        close(session->fd);
+        return -1;
+    }
+    session->seekable = S_ISREG(st.st_mode);
+
+    return 0;
+}
+
+/**
+ * @brief Gets a session that has accepted the SYN ready to receive data packets.
+ *
+ * The file is preallocated, the token bucket is filled, and the writer thread is
+ * started unless io_uring writes the file.
+ *
+ * @param session The session
+ * @param writeRate The maximum number of bytes to write per second, or 0 for no limit
+ * @return Void
+ */
+void start_session(struct Session *session, unsigned long long writeRate)
+{
+    session->positionalWrites = session->seekable && (session->packetDataSize > 0 || session->transferId != 0);
+    preallocate(session);
+
+    if (writeRate > 0)
+    {
+        // The bucket must hold at least one packet, or the window would never open
+        long long capacity = writeRate * WRITE_BURST_TIME / 1000000000ULL;
+        if (capacity < MAX_BUFFER_SIZE)
+        {
+            capacity = MAX_BUFFER_SIZE;
+        }
+        bucket_init(&session->writeBucket, writeRate, capacity, get_time_nsec());
+    }
+
+    // Out-of-order packets wait here until the packets before them arrive
+    session->reorderBuffer = calloc(REORDER_BUFFER_SIZE, sizeof(struct BufferedPacket));
+    if (session->reorderBuffer == NULL)
+    {
+        perror("calloc");
+        exit(1);
+    }
+    session->advertisedWindow = REORDER_BUFFER_SIZE;
+
+    // io_uring writes are asynchronous already, so only the system call loop needs the writer thread
+    if (!_useUring)
+    {
+        writer_start(&session->writer, session->fd, session->seekable, WRITER_RING_SIZE);
+    }
+}
+
+/**
+ * @brief Waits for everything handed to the writer thread to be written, and closes the file.
+ *
+ * @param session The session
+ * @return Void
+ */
+void end_session(struct Session *session)
+{
+    if (session->writer.ring.slots != NULL)
+    {
+        writer_finish(&session->writer);
+    }
+
+    free(session->reorderBuffer);
+    close(session->fd);
+}
+
+/**
+ * @brief Opens the receiver's UDP socket on a port.
+ *
+ * @param myUDPport The port number to listen on
+ * @param reusePort Flag indicating if the socket shares the port with the other worker threads' sockets
+ * @return The socket file descriptor
+ */
+int open_socket(unsigned short int myUDPport, int reusePort)
+{
+    // Initialize socket
+    int sockfd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sockfd < 0)
+    {
+        perror("socket");
+        exit(1);
+    }
+
+    struct sockaddr_in addr;
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(myUDPport);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    // Leave room for a full window of packets from the sender
+    int bufferSize = RECEIVE_BUFFER_SIZE;
+    if (setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize)) < 0)
+    {
+        perror("setsockopt");
+        exit(1);
+    }
+
+    if (reusePort && setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &reusePort, sizeof(reusePort)) < 0)
+    {
+        perror("setsockopt");
+        exit(1);
+    }
+
+    int err = bind(sockfd, (struct sockaddr *)&addr, sizeof(addr));
+    if (err < 0)
+    {
+        perror("bind");
+        exit(1);
+    }
+
+    return sockfd;
+}
+
+/** @brief Writes the bytes received on port myUDPport to a file
+ *         called destinationFile at a rate of writeRate bytes
+ *         per second.
+ *
+ *  If writeRate is 0, then the receiver can write as many bytes
+ *  as possible into destinationFile. Otherwise, if writeRate is
+ *  non-zero then the receiver writes no more than writeRate bytes
+ *  per second to destinationFile. See rsend for the counterpart function.
+ *  The rate is kept by a token bucket holding WRITE_BURST_TIME of writing,
+ *  which limits the window advertised in every ACK, so the sender slows
+ *  down instead of the receiver stalling. A receiver that closed its window
+ *  sends a window update once it has room again.
+ *
+ *  Packets that arrive ahead of a missing packet are held in a reorder
+ *  buffer of REORDER_BUFFER_SIZE packets and acknowledged individually,
+ *  so the sender only retransmits the packets that were actually lost.
+ *  Buffered packets are written to the file as soon as the packets before
+ *  them arrive.
+ *
+ *  If the SYN announced the packet data size, each packet's data is written
+ *  as soon as it arrives, at the offset its sequence number gives. The file is
+ *  preallocated if the SYN also announced the size of the transfer. The writes
+ *  themselves are made by a writer thread, which writes the data of
+ *  consecutive packets together with pwritev, so a slow disk does not hold up
+ *  the receive loop. The room left in its ring is advertised in every ACK.
+ *
+ *  Packets are received in batches with recvmmsg, and the ACKs for a batch
+ *  are sent together with sendmmsg. With UDP GRO, the kernel also coalesces
+ *  consecutive packets into one datagram, which is split back into packets.
+ *  With -U, receive_uring does the same through io_uring instead.
+ *
+ *  @param myUDPport The port number to listen on.
+ *  @param destinationFile The name of the file to write to.
+ *  @param writeRate The maximum number of bytes to write per second.
+ *                   Must be an integer greater than or equal to zero.
+ *  @return Void.
+ *
+ *  Sources:
+ *  https://www.geeksforgeeks.org/socket-programming-cc/
+ *  https://www.gta.ufrj.br/ensino/eel878/sockets/sockaddr_inman.html
+ *  https://www.geeksforgeeks.org/time-function-in-c/
+ *  https://www.ibm.com/docs/en/zos/3.1.0?topic=functions-recvfrom-receive-messages-socket
+ */
+void rrecv(unsigned short int myUDPport,
+           char *destinationFile,
+           unsigned long long int writeRate)
+{
+    int sockfd = open_socket(myUDPport, FALSE);
+
+    // Prepare file for writing
+    struct Session session;
+    memset(&session, 0, sizeof(session));
+    if (open_output(&session, destinationFile, TRUE) < 0)
+    {
+        exit(1);
+    }
 
-    unsigned long long bytesWritten = 0;
+    // Establish connection with sender prior to receiving packets
+    establish_connection(&session, sockfd);
 
-    while (TRUE)
+    // Wake up now and then without packets, to send window updates
+    struct timeval tv;
+    tv.tv_sec = 0;
+    tv.tv_usec = WINDOW_UPDATE_INTERVAL;
+    if (setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0)
+    {
+        perror("timeout");
+        exit(1);
+    }
+
+    enable_gro(sockfd);
+    start_uring(&session, sockfd);
+    start_session(&session, writeRate);
+
+    int lastPacketWritten = FALSE;
+    if (_useUring)
+    {
+        receive_uring(&session, sockfd);
+        lastPacketWritten = TRUE;
+    }
+
+    struct ReceiveBatch *batch = alloc_receive_batch();
+    struct mmsghdr messages[RECEIVE_BATCH_SIZE];
+    struct iovec data[RECEIVE_BATCH_SIZE];
+
+    while (!lastPacketWritten)
+    {
+        for (int i = 0; i < RECEIVE_BATCH_SIZE; i++)
+        {
+            prepare_receive(batch, &messages[i].msg_hdr, &data[i], i);
+        }
+
+        // Block for the first packet, then take whatever else has already arrived
+        int datagramsReceived = recvmmsg(sockfd, messages, RECEIVE_BATCH_SIZE, MSG_WAITFORONE, NULL);
+        if (datagramsReceived < 0)
+        {
+            // A pause from the sender is not an error, and is the time to send a window update
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            {
+                perror("recvmmsg");
+                exit(1);
+            }
+
+            datagramsReceived = 0;
+        }
+
+        for (int i = 0; i < datagramsReceived && !lastPacketWritten; i++)
+        {
+            struct msghdr *message = &messages[i].msg_hdr;
+            int length = messages[i].msg_len;
+            int segmentSize = get_segment_size(message, length);
+
+            // A datagram coalesced by GRO holds several packets back to back
+            for (int offset = 0; offset < length && !lastPacketWritten; offset += segmentSize)
+            {
+                int packetLength = length - offset < segmentSize ? length - offset : segmentSize;
+
+                lastPacketWritten = handle_packet(&session, sockfd, batch->buffers[i] + offset, packetLength,
+                                                  &batch->addresses[i], message->msg_namelen, -1);
+            }
+        }
+
+        flush_acks(sockfd);
+
+        writer_commit(&session.writer);
+
+        if (!lastPacketWritten)
+        {
+            send_window_update(&session, sockfd);
+            flush_acks(sockfd);
+        }
+    }
+
+    // The file is only complete once the writer thread has written everything handed to it
+    if (session.writer.ring.slots != NULL)
+    {
+        writer_finish(&session.writer);
+    }
+
+    // Answer retransmissions in case the ACK for the last packet was lost
+    linger(&session, sockfd, batch);
+    free(batch);
+
+    end_session(&session);
+    close(sockfd);
+}
+
+/**
+ * @brief Answers a SYN received by the receiver daemon, starting a session for it if it is new.
+ *
+ * A retransmitted SYN gets the same SYN-ACK as the first one. The sender's
+ * final ACK of the handshake carries no connection ID and is not needed, as
+ * the session starts with the SYN, so the daemon ignores it.
+ *
+ * @param worker The worker thread the SYN was received by
+ * @param packet The SYN
+ * @param addr The address of the sender
+ * @param addrlen The length of the address
+ * @return Void
+ */
+void answer_syn(struct Worker *worker, char *packet, struct sockaddr_in *addr, socklen_t addrlen)
+{
+    struct SessionTable *table = &worker->sessions;
+    struct Syn syn;
+    memcpy(&syn, packet, sizeof(syn));
+    uint32_t connectionId = ntohl(syn.connectionId);
+
+    // A sender that picked no connection ID cannot be told apart from the others
+    if (connectionId == 0)
+    {
+        return;
+    }
+
+    struct Session *session = session_find(table, connectionId);
+    if (session == NULL)
     {
-        int packetSize = MAX_BUFFER_SIZE + HEADER_SIZE;
-        char packet[packetSize];
+        // The sender retries the SYN until a session ends
+        if (table->count >= MAX_SESSIONS)
+        {
+            return;
+        }
 
-        int bytesReceived = recvfrom(sockfd, packet, packetSize, 0, (struct sockaddr *)&addr, &addrlen);
-        if (bytesReceived < 0)
+        session = calloc(1, sizeof(struct Session));
+        if (session == NULL)
         {
-            perror("recvfrom");
+            perror("calloc");
             exit(1);
         }
-        else if (bytesReceived == 0)
+
+        accept_syn(session, &syn);
+
+        // The sub-flows of a striped transfer share a file, which the first of them may already have written to
+        char filename[PATH_MAX];
+        uint32_t fileId = session->transferId != 0 ? session->transferId : connectionId;
+        snprintf(filename, sizeof(filename), "%s/%08x", worker->directory, fileId);
+        if (open_output(session, filename, session->transferId == 0) < 0)
         {
-            continue;
+            free(session);
+            return;
+        }
+
+        session->address = *addr;
+        session->addressLength = addrlen;
+        session->synAckSequenceNumber = rand();
+        start_session(session, worker->writeRate);
+        session_insert(table, session);
+
+        if (session->transferId != 0)
+        {
+            fprintf(stderr, "session %08x: started by %s:%d for transfer %08x on worker %u\n", connectionId,
+                    inet_ntoa(addr->sin_addr), ntohs(addr->sin_port), session->transferId, worker->index);
+        }
+        else
+        {
+            fprintf(stderr, "session %08x: started by %s:%d on worker %u\n", connectionId, inet_ntoa(addr->sin_addr),
+                    ntohs(addr->sin_port), worker->index);
+        }
+    }
+    else if (session->firstSequenceNumber != ntohl(syn.sequenceNumber))
+    {
+        // Another sender that happened to pick the same connection ID
+        return;
+    }
+
+    session->lastActivity = get_time_nsec();
+
+    struct SynAck synAck;
+    synAck.sequenceNumber = htonl(session->synAckSequenceNumber);
+    synAck.ackNumber = htonl(session->firstSequenceNumber + 1);
+    sendto(worker->sockfd, &synAck, sizeof(synAck), 0, (struct sockaddr *)addr, addrlen);
+}
+
+/**
+ * @brief Hands a packet received by the receiver daemon to the session it belongs to.
+ *
+ * @param worker The worker thread the packet was received by
+ * @param packet The packet
+ * @param length The length of the packet
+ * @param addr The address of the sender
+ * @param addrlen The length of the address
+ * @return Void
+ */
+void dispatch_packet(struct Worker *worker, char *packet, int length, struct sockaddr_in *addr, socklen_t addrlen)
+{
+    struct Header header;
+    if (header_decode(&header, packet, length) < 0)
+    {
+        // Data packets are checked first, as the last one of a file may be as short as a SYN
+        if (length == sizeof(struct Syn))
+        {
+            answer_syn(worker, packet, addr, addrlen);
         }
+        return;
+    }
+
+    uint8_t idLength;
+    const void *id = header_find_extension(packet, HEADER_EXTENSION_CONNECTION_ID, &idLength);
+    if (id == NULL || idLength != sizeof(uint32_t))
+    {
+        return;
+    }
+
+    uint32_t connectionId;
+    memcpy(&connectionId, id, sizeof(connectionId));
+
+    // Packets of a session that has ended are dropped, and the sender gives up on them
+    struct Session *session = session_find(&worker->sessions, ntohl(connectionId));
+    if (session == NULL)
+    {
+        return;
+    }
+
+    session->lastActivity = get_time_nsec();
+    if (handle_packet(session, worker->sockfd, packet, length, addr, addrlen, -1))
+    {
+        session->finished = TRUE;
+    }
+}
 
-        struct Header header;
-        memcpy(&header, packet, HEADER_SIZE);
-        send_packet_ack(sockfd, &addr, addrlen, header.sequenceNumber);
+/**
+ * @brief Sends the window updates of the receiver daemon's sessions, and ends the sessions that went quiet.
+ *
+ * A session whose last packet has been written ends once no packet has arrived
+ * for LINGER_TIMEOUT, which gives the sender time to retransmit packets whose
+ * ACK was lost. Any other session ends once it has been idle for SESSION_IDLE_TIMEOUT.
+ *
+ * @param worker The worker thread
+ * @return Void
+ */
+void tick_sessions(struct Worker *worker)
+{
+    struct SessionTable *table = &worker->sessions;
+    int sockfd = worker->sockfd;
 
-        char packet_data[header.messageLength];
-        memcpy(packet_data, packet + HEADER_SIZE, header.messageLength);
+    struct Session *ended[MAX_SESSIONS];
+    int endedCount = 0;
+    unsigned long long now = get_time_nsec();
 
-        // If packet's sequence number has already been received, discard duplicate
-        if (header.sequenceNumber <= _latestSequenceNumber)
+    for (unsigned i = 0; i < table->size; i++)
+    {
+        struct Session *session = table->entries[i];
+        if (session == NULL)
         {
             continue;
         }
 
-        fwrite(packet_data, 1, header.messageLength, file);
+        unsigned long long timeout = session->finished ? LINGER_TIMEOUT : SESSION_IDLE_TIMEOUT;
+        if (now - session->lastActivity >= timeout * 1000ULL)
+        {
+            ended[endedCount++] = session;
+            continue;
+        }
 
-        if (header.lastPacket == TRUE)
+        if (!session->finished)
         {
-            break;
+            send_window_update(session, sockfd);
+        }
+    }
+    flush_acks(sockfd);
+
+    // Sessions are only removed once the scan is over, as removing one moves others in the table
+    for (int i = 0; i < endedCount; i++)
+    {
+        struct Session *session = ended[i];
+
+        session_remove(table, session);
+        end_session(session);
+
+        fprintf(stderr, "session %08x: %s after %llu bytes\n", session->connectionId,
+                session->finished ? "finished" : "timed out", session->bytesWritten);
+        free(session);
+    }
+}
+
+/**
+ * @brief A worker thread of the receiver daemon, which runs until the daemon is killed.
+ *
+ * The worker waits with epoll on its socket and on a timer firing every
+ * WINDOW_UPDATE_INTERVAL. Packets are received in batches with recvmmsg and
+ * handed to their session, found in the worker's own hash table by connection
+ * ID; the timer sends window updates and ends the sessions that have gone quiet.
+ *
+ * @param arg The worker
+ * @return Does not return
+ */
+void *serve_worker(void *arg)
+{
+    struct Worker *worker = arg;
+    int sockfd = worker->sockfd;
+    struct SessionTable *table = &worker->sessions;
+
+    enable_gro(sockfd);
+
+    if (fcntl(sockfd, F_SETFL, fcntl(sockfd, F_GETFL) | O_NONBLOCK) < 0)
+    {
+        perror("fcntl");
+        exit(1);
+    }
+
+    int timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    if (timerfd < 0)
+    {
+        perror("timerfd_create");
+        exit(1);
+    }
+
+    struct itimerspec interval;
+    interval.it_interval.tv_sec = 0;
+    interval.it_interval.tv_nsec = WINDOW_UPDATE_INTERVAL * 1000;
+    interval.it_value = interval.it_interval;
+    if (timerfd_settime(timerfd, 0, &interval, NULL) < 0)
+    {
+        perror("timerfd_settime");
+        exit(1);
+    }
+
+    int epollfd = epoll_create1(0);
+    if (epollfd < 0)
+    {
+        perror("epoll_create1");
+        exit(1);
+    }
+
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = sockfd;
+    if (epoll_ctl(epollfd, EPOLL_CTL_ADD, sockfd, &event) < 0)
+    {
+        perror("epoll_ctl");
+        exit(1);
+    }
+
+    event.data.fd = timerfd;
+    if (epoll_ctl(epollfd, EPOLL_CTL_ADD, timerfd, &event) < 0)
+    {
+        perror("epoll_ctl");
+        exit(1);
+    }
+
+    session_table_init(table, MAX_SESSIONS);
+
+    struct ReceiveBatch *batch = alloc_receive_batch();
+    struct mmsghdr messages[RECEIVE_BATCH_SIZE];
+    struct iovec data[RECEIVE_BATCH_SIZE];
+    struct epoll_event events[2];
+
+    while (TRUE)
+    {
+        int ready = epoll_wait(epollfd, events, 2, -1);
+        if (ready < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            perror("epoll_wait");
+            exit(1);
+        }
+
+        for (int e = 0; e < ready; e++)
+        {
+            if (events[e].data.fd == timerfd)
+            {
+                uint64_t expirations;
+                if (read(timerfd, &expirations, sizeof(expirations)) > 0)
+                {
+                    tick_sessions(worker);
+                }
+                continue;
+            }
+
+            // One batch per wakeup, so the timer is not held up while the socket stays busy
+            for (int i = 0; i < RECEIVE_BATCH_SIZE; i++)
+            {
+                prepare_receive(batch, &messages[i].msg_hdr, &data[i], i);
+            }
+
+            int datagramsReceived = recvmmsg(sockfd, messages, RECEIVE_BATCH_SIZE, MSG_DONTWAIT, NULL);
+            if (datagramsReceived < 0)
+            {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                {
+                    perror("recvmmsg");
+                    exit(1);
+                }
+
+                continue;
+            }
+
+            for (int i = 0; i < datagramsReceived; i++)
+            {
+                struct msghdr *message = &messages[i].msg_hdr;
+                int length = messages[i].msg_len;
+                int segmentSize = get_segment_size(message, length);
+
+                // A datagram coalesced by GRO holds several packets back to back
+                for (int offset = 0; offset < length; offset += segmentSize)
+                {
+                    int packetLength = length - offset < segmentSize ? length - offset : segmentSize;
+
+                    dispatch_packet(worker, batch->buffers[i] + offset, packetLength, &batch->addresses[i],
+                                    message->msg_namelen);
+                }
+            }
+
+            flush_acks(sockfd);
+
+            // Hand every session's data to its writer thread
+            for (unsigned i = 0; i < table->size; i++)
+            {
+                if (table->entries[i] != NULL)
+                {
+                    writer_commit(&table->entries[i]->writer);
+                }
+            }
         }
+    }
+}
+
+/**
+ * @brief Makes the kernel hand every packet of a transfer to the same worker thread.
+ *
+ * A classic BPF program attached to the port's SO_REUSEPORT group picks the
+ * socket for each packet from its connection ID, modulo the number of worker
+ * threads: from the extension at CONNECTION_ID_OFFSET in a data packet, or
+ * from the SYN. Other packets, such as the sender's final ACK of the
+ * handshake, are left to the kernel's hash of the addresses. Sockets are
+ * numbered in the order they joined the group.
+ *
+ * The length of a data packet is not checked, as one coalesced by UDP GRO
+ * holds several packets.
+ *
+ * @param sockfd A socket of the group
+ * @param threads The number of worker threads
+ * @return Void
+ */
+void steer_sessions(int sockfd, unsigned threads)
+{
+    struct sock_filter code[] = {
+        // A data packet of this version whose first extension is the connection ID
+        BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 0),
+        BPF_STMT(BPF_ALU | BPF_RSH | BPF_K, 4),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, PROTOCOL_VERSION, 0, 8),
+        BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 1),
+        BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, CONNECTION_ID_OFFSET + sizeof(uint32_t), 0, 6),
+        BPF_STMT(BPF_LD | BPF_B | BPF_ABS, HEADER_SIZE),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, HEADER_EXTENSION_CONNECTION_ID, 0, 4),
+        BPF_STMT(BPF_LD | BPF_B | BPF_ABS, HEADER_SIZE + 1),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, sizeof(uint32_t), 0, 2),
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, CONNECTION_ID_OFFSET),
+        BPF_JUMP(BPF_JMP | BPF_JA, 3, 0, 0),
+
+        // A SYN
+        BPF_STMT(BPF_LD | BPF_W | BPF_LEN, 0),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, sizeof(struct Syn), 0, 3),
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct Syn, connectionId)),
+
+        BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, threads),
+        BPF_STMT(BPF_RET | BPF_A, 0),
+
+        // No socket of the group has this index, so the kernel falls back to its hash
+        BPF_STMT(BPF_RET | BPF_K, 0xffffffff),
+    };
+
+    struct sock_fprog program;
+    program.len = sizeof(code) / sizeof(code[0]);
+    program.filter = code;
+
+    if (setsockopt(sockfd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program, sizeof(program)) < 0)
+    {
+        perror("SO_ATTACH_REUSEPORT_CBPF");
+        exit(1);
+    }
+}
+
+/** @brief Receives any number of transfers at once on port myUDPport,
+ *         writing each one to its own file in directory.
+ *
+ *  This is the receiver daemon (-D), which runs until it is killed. Every
+ *  sender picks a random connection ID, announces it in its SYN and puts it
+ *  in every data packet, so the daemon can tell the transfers sharing the
+ *  port apart. The file of each transfer is named after its connection ID,
+ *  as eight hexadecimal digits, and is written as rrecv would write it,
+ *  each session with its own writer thread and held to writeRate on its own.
+ *
+ *  The sessions are shared out among worker threads, each with its own socket
+ *  bound to the port with SO_REUSEPORT. The kernel hands every packet of a
+ *  transfer to the same socket, by connection ID, so a worker has its own
+ *  sessions and receive buffers and never takes a lock for a packet. Worker 0
+ *  runs on the calling thread.
+ *
+ *  @param myUDPport The port number to listen on.
+ *  @param directory The directory to write the files to.
+ *  @param writeRate The maximum number of bytes each transfer writes per second, or 0 for no limit.
+ *  @param threads The number of worker threads, from 1 to MAX_WORKERS.
+ *  @return Does not return.
+ */
+void serve(unsigned short int myUDPport,
+           char *directory,
+           unsigned long long int writeRate,
+           unsigned threads)
+{
+    struct Worker workers[MAX_WORKERS];
+
+    srand(time(NULL));
 
-        bytesWritten += bytesReceived;
-        _latestSequenceNumber = header.sequenceNumber;
+    // Every socket joins the group before any packet is steered by its index
+    for (unsigned i = 0; i < threads; i++)
+    {
+        workers[i].index = i;
+        workers[i].sockfd = open_socket(myUDPport, threads > 1);
+        workers[i].directory = directory;
+        workers[i].writeRate = writeRate;
+    }
 
-        time(&end);
-        double seconds = difftime(end, start);
+    if (threads > 1)
+    {
+        steer_sessions(workers[0].sockfd, threads);
+    }
 
-        // If writeRate exceeded, signal to sender to slow down
-        if (writeRate > 0 && bytesWritten / seconds > writeRate)
+    for (unsigned i = 1; i < threads; i++)
+    {
+        int err = pthread_create(&workers[i].thread, NULL, serve_worker, &workers[i]);
+        if (err != 0)
         {
-            sleep(1);
+            fprintf(stderr, "pthread_create: %s\n", strerror(err));
+            exit(1);
         }
     }
 
-    fclose(file);
-    close(sockfd);
+    serve_worker(&workers[0]);
+}
+
+/** @brief Prints the command line usage and exits.
+ *
+ *  @param program The name the program was run as.
+ *  @return Does not return
+ */
+void print_usage(char *program)
+{
+    fprintf(stderr, "usage: %s [-U] [-D] [-T threads] UDP_port filename_or_directory [writeRate]\n\n", program);
+    exit(1);
 }
 
 /** @brief UDP receiver entrypoint.
  *
  *  Parses the command line arguments and calls the rrecv function
- *  to receive the file. If writeRate is not specified, then the
- *  default value is 0.
+ *  to receive the file, or with -D, the serve function to receive
+ *  files into a directory until killed. If writeRate is not specified,
+ *  then the default value is 0.
  *
  *  @return Should not return
  */
@@ -309,22 +1935,67 @@ int main(int argc, char **argv)
     unsigned short int udpPort;
     char *destinationFile = NULL;
     unsigned long long int writeRate;
+    int serveDirectory = FALSE;
+    int threads = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "UDT:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'U':
+            _useUring = TRUE;
+            break;
+        case 'D':
+            serveDirectory = TRUE;
+            break;
+        case 'T':
+            threads = atoi(optarg);
+            if (threads < 1 || threads > MAX_WORKERS)
+            {
+                fprintf(stderr, "threads must be between 1 and %d\n", MAX_WORKERS);
+                print_usage(argv[0]);
+            }
+            break;
+        default:
+            print_usage(argv[0]);
+        }
+    }
+
+    // The io_uring loop only knows how to receive a single transfer
+    if (serveDirectory && _useUring)
+    {
+        fprintf(stderr, "-U cannot be used with -D\n");
+        print_usage(argv[0]);
+    }
 
-    udpPort = (unsigned short int)atoi(argv[1]);
-    destinationFile = argv[2];
+    // Only the receiver daemon shares its sessions out among threads
+    if (!serveDirectory && threads > 1)
+    {
+        fprintf(stderr, "-T can only be used with -D\n");
+        print_usage(argv[0]);
+    }
 
-    if (argc == 4)
+    int positional = argc - optind;
+    if (positional == 3)
     {
-        writeRate = (unsigned long long int)atoll(argv[3]);
+        writeRate = (unsigned long long int)atoll(argv[optind + 2]);
     }
-    else if (argc == 3)
+    else if (positional == 2)
     {
         writeRate = 0;
     }
     else
     {
-        fprintf(stderr, "usage: %s UDP_port filename_to_write [writeRate]\n\n", argv[0]);
-        exit(1);
+        print_usage(argv[0]);
+    }
+
+    udpPort = (unsigned short int)atoi(argv[optind]);
+    destinationFile = argv[optind + 1];
+
+    if (serveDirectory)
+    {
+        serve(udpPort, destinationFile, writeRate, threads);
     }
 
     rrecv(udpPort, destinationFile, writeRate);
@@ -0,0 +1,173 @@
+/** @file ring.c
+ *  @brief A lock-free single-producer/single-consumer ring of buffers
+ *
+ *  The producer fills buffers and publishes them by moving the tail, and
+ *  the consumer gives them back by moving the head, so neither side ever
+ *  writes what the other owns.
+ *
+ *  A side that finds the ring empty (or full) sets its waiting flag,
+ *  checks the ring again and sleeps on a futex. The other side checks the
+ *  flag after it moves its end of the ring, and only then makes the
+ *  system call to wake it, so a busy transfer runs without any. Both
+ *  steps are sequentially consistent, so at least one side always sees
+ *  the other's store and no wakeup is lost.
+ *
+ *  @author Vicky Chen (chen-vv)
+ *  @author Eric Omielan (eomielan)
+ *  @bug No known bugs.
+ */
+
+/* -- Includes -- */
+
+#include <errno.h>
+#include <linux/futex.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "include/ring.h"
+
+/**
+ * @brief Sleeps until a futex is woken, unless it no longer holds a value.
+ *
+ * @param word The futex
+ * @param value The value the futex held when the caller decided to sleep
+ * @return Void
+ */
+void futex_wait(uint32_t *word, uint32_t value)
+{
+    if (syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0) < 0 &&
+        errno != EAGAIN && errno != EINTR)
+    {
+        perror("futex");
+        exit(1);
+    }
+}
+
+/**
+ * @brief Bumps a futex and wakes the thread sleeping on it.
+ *
+ * @param word The futex
+ * @return Void
+ */
+void futex_wake(uint32_t *word)
+{
+    __atomic_fetch_add(word, 1, __ATOMIC_SEQ_CST);
+    syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+void ring_init(struct Ring *ring, unsigned entries, size_t slotSize)
+{
+    ring->slotSize = slotSize;
+    ring->entries = entries;
+    ring->head = 0;
+    ring->tail = 0;
+    ring->reserved = 0;
+    ring->closed = 0;
+    ring->producerWaiting = 0;
+    ring->consumerWaiting = 0;
+    ring->spaceSignal = 0;
+    ring->dataSignal = 0;
+
+    ring->slots = malloc(entries * slotSize);
+    if (ring->slots == NULL)
+    {
+        perror("malloc");
+        exit(1);
+    }
+}
+
+void *ring_slot(struct Ring *ring, uint32_t position)
+{
+    return ring->slots + (size_t)(position & (ring->entries - 1)) * ring->slotSize;
+}
+
+void *ring_reserve(struct Ring *ring)
+{
+    while (ring->reserved - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == ring->entries)
+    {
+        // The consumer can only give back buffers it has been handed
+        ring_commit(ring);
+
+        // Announce the sleep before checking again, so a release after the check sees it and wakes us
+        uint32_t signal = __atomic_load_n(&ring->spaceSignal, __ATOMIC_SEQ_CST);
+        __atomic_store_n(&ring->producerWaiting, 1, __ATOMIC_SEQ_CST);
+        if (ring->reserved - __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) == ring->entries)
+        {
+            futex_wait(&ring->spaceSignal, signal);
+        }
+        __atomic_store_n(&ring->producerWaiting, 0, __ATOMIC_SEQ_CST);
+    }
+
+    return ring_slot(ring, ring->reserved++);
+}
+
+void ring_commit(struct Ring *ring)
+{
+    if (ring->tail == ring->reserved)
+    {
+        return;
+    }
+
+    // The buffers must be filled before the consumer can see the new tail
+    __atomic_store_n(&ring->tail, ring->reserved, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->consumerWaiting, __ATOMIC_SEQ_CST))
+    {
+        futex_wake(&ring->dataSignal);
+    }
+}
+
+void ring_close(struct Ring *ring)
+{
+    ring_commit(ring);
+
+    __atomic_store_n(&ring->closed, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->consumerWaiting, __ATOMIC_SEQ_CST))
+    {
+        futex_wake(&ring->dataSignal);
+    }
+}
+
+unsigned ring_space(struct Ring *ring)
+{
+    return ring->entries - (ring->reserved - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE));
+}
+
+uint32_t ring_wait(struct Ring *ring, uint32_t position)
+{
+    while (1)
+    {
+        uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        if (tail != position || __atomic_load_n(&ring->closed, __ATOMIC_ACQUIRE))
+        {
+            return tail;
+        }
+
+        // Announce the sleep before checking again, so a handover after the check sees it and wakes us
+        uint32_t signal = __atomic_load_n(&ring->dataSignal, __ATOMIC_SEQ_CST);
+        __atomic_store_n(&ring->consumerWaiting, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST) == position &&
+            !__atomic_load_n(&ring->closed, __ATOMIC_SEQ_CST))
+        {
+            futex_wait(&ring->dataSignal, signal);
+        }
+        __atomic_store_n(&ring->consumerWaiting, 0, __ATOMIC_SEQ_CST);
+    }
+}
+
+void ring_release(struct Ring *ring, uint32_t position)
+{
+    // The buffers must be consumed before the producer can see them as free
+    __atomic_store_n(&ring->head, position, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->producerWaiting, __ATOMIC_SEQ_CST))
+    {
+        futex_wake(&ring->spaceSignal);
+    }
+}
+
+void ring_destroy(struct Ring *ring)
+{
+    free(ring->slots);
+    ring->slots = NULL;
+}
@@ -14,209 +14,2134 @@
 
 /* -- Includes -- */
 
+#define _GNU_SOURCE // For ppoll and sendmmsg
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <netinet/udp.h>
 #include <netdb.h>
+#include <time.h>
+#include <endian.h>
 #include <sys/time.h>
 #include <sys/stat.h>
+#include <sys/random.h>
 
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
 
 #include <pthread.h>
+#include <signal.h>
 #include <errno.h>
+#include <linux/errqueue.h>
+#include "include/bucket.h"
+#include "include/congestion.h"
+#include "include/pacer.h"
+#include "include/source.h"
+#include "include/stripe.h"
+#include "include/uring.h"
 #include "include/udp.h"
 
 /* -- Global Variables -- */
 
 /**
- * @brief The sequence number used to keep track of the packets sent.
+ * @brief The sequence number used to keep track of the packets sent.
+ *
+ * This variable holds the sequence number that will be given to the next new
+ * packet sent to the receiver. The sequence number is used to ensure that
+ * the packets are not duplicated or lost.
+ *
+ * Like every variable that describes the connection, it is per thread, as each
+ * sub-flow of a striped transfer is a connection of its own on its own thread.
+ * The variables set from the command line are shared.
+ */
+__thread uint32_t _sequenceNumber = 0;
+
+/**
+ * @brief The sequence number of the first data packet.
+ *
+ * Set during the 3-way handshake. Packets are placed in the window relative to
+ * this value.
+ */
+__thread uint32_t _initialSequenceNumber = 0;
+
+/**
+ * @brief The connection ID of the transfer, announced in the SYN and carried by every data packet.
+ *
+ * A receiver serving many senders on one port finds the transfer of each packet by it.
+ */
+__thread uint32_t _connectionId = 0;
+
+/**
+ * @brief The ID shared by every sub-flow of a striped transfer, announced in each SYN, or 0.
+ *
+ * The receiver writes the sub-flows with the same transfer ID to one file.
+ */
+uint32_t _transferId = 0;
+
+/**
+ * @brief The number of sub-flows the file is sent over.
+ *
+ * Defaults to 1 and can be changed on the command line.
+ */
+int _stripes = 1;
+
+/**
+ * @brief The sequence number of the oldest unacknowledged packet.
+ *
+ * This is the left edge of the sliding window. Every packet before it has been
+ * acknowledged by the receiver.
+ */
+__thread uint32_t _baseSequenceNumber = 0;
+
+/**
+ * @brief The sequence number just past the last packet the receiver has room for.
+ *
+ * Taken from the window of the newest ACK. New packets are only sent before it.
+ */
+__thread uint32_t _receiveWindowEnd = 0;
+
+/**
+ * @brief The cumulative acknowledgment of the ACK _receiveWindowEnd was taken from.
+ *
+ * An ACK that arrives late, with an older cumulative acknowledgment, does not change the window.
+ */
+__thread uint32_t _receiveWindowAck = 0;
+
+/**
+ * @brief Time _receiveWindowEnd was last taken from an ACK, in microseconds.
+ *
+ * A closed window is probed once no ACK has changed it for a while.
+ */
+__thread unsigned long long _receiveWindowTime = 0;
+
+/**
+ * @brief The number of probes sent into the closed receive window since the receiver last advertised room.
+ *
+ * Every probe doubles the wait before the next, as a retransmission does, since
+ * the receiver takes in each probe even if it cannot keep up.
+ */
+__thread int _windowProbes = 0;
+
+/**
+ * @brief The maximum number of packets that may be in flight at once.
+ *
+ * Defaults to DEFAULT_WINDOW_SIZE and can be changed on the command line.
+ */
+int _windowSize = DEFAULT_WINDOW_SIZE;
+
+/**
+ * @brief The send state of every packet in the window.
+ *
+ * A circular buffer of _windowSize entries. Use get_packet_state to look up
+ * the entry for a sequence number.
+ */
+__thread struct PacketState *_window = NULL;
+
+/**
+ * @brief The smoothed round-trip time (SRTT), in microseconds.
+ *
+ * Zero until the first round-trip time sample has been taken.
+ */
+__thread unsigned long long _smoothedRtt = 0;
+
+/**
+ * @brief The round-trip time variation (RTTVAR), in microseconds.
+ */
+__thread unsigned long long _rttVariation = 0;
+
+/**
+ * @brief The smallest round-trip time sample taken, in microseconds.
+ *
+ * Zero until the first round-trip time sample has been taken.
+ */
+__thread unsigned long long _minRtt = 0;
+
+/**
+ * @brief The current retransmission timeout (RTO), in microseconds.
+ *
+ * Starts at DEFAULT_TIMEOUT and is recomputed from _smoothedRtt and
+ * _rttVariation after every round-trip time sample.
+ */
+__thread unsigned long long _retransmissionTimeout = DEFAULT_TIMEOUT;
+
+/**
+ * @brief The largest retransmission timeout reached by backing off, in microseconds.
+ *
+ * Defaults to MAX_TIMEOUT and can be changed on the command line.
+ */
+unsigned long long _maxTimeout = MAX_TIMEOUT;
+
+/**
+ * @brief The number of times a packet may time out before the transfer is abandoned.
+ *
+ * Defaults to MAX_RETRIES and can be changed on the command line. If 0, packets
+ * are retransmitted forever.
+ */
+int _maxRetries = MAX_RETRIES;
+
+/**
+ * @brief The number of packets sent that are neither acknowledged nor considered lost.
+ */
+__thread unsigned int _packetsInFlight = 0;
+
+/**
+ * @brief The number of packets considered lost that are waiting to be retransmitted.
+ */
+__thread unsigned int _packetsLost = 0;
+
+/**
+ * @brief The total number of bytes acknowledged by the receiver so far.
+ *
+ * Used with the per-packet delivery state to sample the delivery rate.
+ */
+__thread unsigned long long _delivered = 0;
+
+/**
+ * @brief The time _delivered last grew, in microseconds.
+ */
+__thread unsigned long long _deliveredTime = 0;
+
+/**
+ * @brief The send time of the first packet of the current flight, in microseconds.
+ */
+__thread unsigned long long _firstSentTime = 0;
+
+/**
+ * @brief Delivery rate samples are application-limited until this many bytes are delivered.
+ *
+ * Set when the sender runs out of data to send before the congestion window
+ * is full, or 0 if the sender is not application-limited.
+ */
+__thread unsigned long long _appLimited = 0;
+
+/**
+ * @brief The congestion control algorithm used by the sender.
+ *
+ * Defaults to DEFAULT_CONGESTION_CONTROL and can be changed on the command line.
+ */
+const struct CongestionOps *_congestionAlgorithm = NULL;
+
+/**
+ * @brief Flag indicating if window-based congestion control algorithms are paced.
+ *
+ * Set on the command line. When set, packets are paced at the congestion
+ * window per smoothed round-trip time. Algorithms that set their own pacing
+ * rate, such as BBR, are always paced.
+ */
+int _pacing = FALSE;
+
+/**
+ * @brief A fixed rate to pace packets at, in bytes per second, or 0 to use the congestion control rate.
+ *
+ * Set on the command line. The congestion window still applies.
+ */
+unsigned long long _fixedPacingRate = 0;
+
+/**
+ * @brief The token bucket that holds the sender to its rate limit.
+ *
+ * Its rate is 0 if there is no limit. Retransmissions count against the limit
+ * too, and the congestion window still applies, so the lower of the two wins.
+ */
+__thread struct TokenBucket _rateLimit;
+
+/**
+ * @brief The file a new rate limit is read from on SIGUSR1, or NULL.
+ *
+ * Set on the command line.
+ */
+char *_rateLimitFile = NULL;
+
+/**
+ * @brief Flag set by SIGUSR1, telling the send loop to read a new rate limit from _rateLimitFile.
+ */
+volatile sig_atomic_t _rateLimitChanged = FALSE;
+
+/**
+ * @brief The pacing state of the transfer.
+ */
+__thread struct Pacer _pacer;
+
+/**
+ * @brief The messages passed to sendmmsg to send the queued packets.
+ *
+ * With GSO, one message carries several consecutive packets.
+ */
+__thread struct mmsghdr _sendBatch[SEND_BATCH_SIZE];
+
+/**
+ * @brief The control data (the GSO segment size) of each message in _sendBatch.
+ */
+__thread union
+{
+    char buffer[CMSG_SPACE(sizeof(uint16_t))];
+    struct cmsghdr align;
+} _sendBatchControl[SEND_BATCH_SIZE];
+
+/**
+ * @brief The packets waiting to be sent with the next sendmmsg call.
+ */
+__thread struct PacketState *_sendBatchPackets[SEND_BATCH_SIZE];
+
+/**
+ * @brief The header and data of each packet in _sendBatchPackets, two entries per packet.
+ *
+ * The kernel gathers the header and the data into one datagram, so data sent
+ * from the mapped file is never copied by the sender.
+ */
+__thread struct iovec _sendBatchData[SEND_BATCH_SIZE * 2];
+
+/**
+ * @brief The number of packets in _sendBatchPackets.
+ */
+__thread int _sendBatchCount = 0;
+
+/**
+ * @brief Flag indicating if UDP GSO is to be used, unless it is cleared on the command line.
+ */
+int _gsoRequested = TRUE;
+
+/**
+ * @brief Flag indicating if consecutive packets are sent as UDP GSO super-buffers.
+ *
+ * Copied from _gsoRequested when a connection starts, and cleared when the
+ * kernel or the network device does not support UDP segmentation offload.
+ * It is per thread, so a sub-flow falling back does not change the others.
+ */
+__thread int _gso = FALSE;
+
+/**
+ * @brief The number of GSO super-buffers sent.
+ */
+__thread unsigned long long _gsoBuffers = 0;
+
+/**
+ * @brief The number of packets sent in GSO super-buffers.
+ */
+__thread unsigned long long _gsoSegments = 0;
+
+/**
+ * @brief The number of packets sent, including retransmissions.
+ */
+__thread unsigned long long _packetsSent = 0;
+
+/**
+ * @brief The number of sendmmsg calls made to send the packets.
+ */
+__thread unsigned long long _sendCalls = 0;
+
+/**
+ * @brief Flag indicating if the file is mapped into memory rather than read with buffered reads.
+ *
+ * Cleared on the command line. Files that cannot be mapped are always read.
+ */
+int _mapFile = TRUE;
+
+/**
+ * @brief The largest amount of file data carried by a packet, in bytes.
+ *
+ * Defaults to MAX_BUFFER_SIZE and can be lowered on the command line.
+ */
+int _packetDataSize = MAX_BUFFER_SIZE;
+
+/**
+ * @brief Flag indicating if MSG_ZEROCOPY is to be used, as set on the command line.
+ */
+int _zerocopyRequested = FALSE;
+
+/**
+ * @brief Flag indicating if packets are sent with MSG_ZEROCOPY.
+ *
+ * Copied from _zerocopyRequested when a connection starts, and cleared if the
+ * kernel does not support it. The kernel then reads the data of a packet straight from the window (or the
+ * mapped file) after the send call returns, so a window entry is not reused
+ * and the file is not unmapped until the kernel reports the send complete.
+ */
+int _zerocopy = FALSE;
+
+/**
+ * @brief The ID the kernel gives the next MSG_ZEROCOPY send.
+ *
+ * The kernel numbers every successful MSG_ZEROCOPY send on the socket, starting at 0.
+ */
+__thread uint32_t _zerocopyNext = 0;
+
+/**
+ * @brief The ID of the oldest MSG_ZEROCOPY send that has not completed.
+ *
+ * Every send before it has completed, so the kernel no longer uses its data.
+ */
+__thread uint32_t _zerocopyOldest = 0;
+
+/**
+ * @brief Flags indicating which sends from _zerocopyOldest on have completed, indexed by ID.
+ *
+ * Completions may be reported out of order.
+ */
+__thread u_char _zerocopyDone[ZEROCOPY_MAX_PENDING];
+
+/**
+ * @brief The number of MSG_ZEROCOPY sends the kernel completed by copying the data anyway.
+ */
+__thread unsigned long long _zerocopyCopied = 0;
+
+/**
+ * @brief Flag indicating if io_uring is to be used, as set on the command line.
+ */
+int _uringRequested = FALSE;
+
+/**
+ * @brief Flag indicating if packets are sent and ACKs received through io_uring.
+ *
+ * Copied from _uringRequested when a connection starts, and cleared if the
+ * kernel has no usable io_uring. Otherwise, the sender makes the system calls
+ * itself.
+ */
+__thread int _useUring = FALSE;
+
+/**
+ * @brief The io_uring the sends and ACK receives go through.
+ */
+__thread struct Uring _uring;
+
+/**
+ * @brief The buffers ACKs are received into through io_uring.
+ *
+ * A single multishot receive picks a buffer for each ACK as it arrives. It
+ * completes with user data 1, and sends complete with user data 0.
+ */
+__thread struct UringBuffers _uringAcks;
+
+/**
+ * @brief Flag indicating if the multishot ACK receive is outstanding.
+ */
+__thread int _uringReceiving = FALSE;
+
+/**
+ * @brief The IDs of the buffers in _uringAcks holding ACKs not processed yet, in arrival order.
+ */
+__thread uint16_t _uringReadyAcks[URING_ACK_BUFFERS];
+
+/**
+ * @brief The number of bytes received into each buffer in _uringReadyAcks.
+ */
+__thread int _uringReadyLengths[URING_ACK_BUFFERS];
+
+/**
+ * @brief The number of buffers in _uringReadyAcks.
+ */
+__thread int _uringReadyCount = 0;
+
+/**
+ * @brief Flag indicating if transfer statistics are printed at the end.
+ *
+ * Set on the command line.
+ */
+int _verbose = FALSE;
+
+/**
+ * @brief The congestion control state of the transfer.
+ *
+ * No more than _congestion.cwnd packets are in flight at once.
+ */
+__thread struct CongestionControl _congestion;
+
+/**
+ * @brief Establishes a connection with the receiver using the 3-way handshake process.
+ *
+ * Sends a SYN packet to the receiver and waits for a SYN-ACK packet. Upon receiving
+ * the SYN-ACK packet, the function sends a single ACK packet to the receiver and
+ * assumes the connection is established.
+ *
+ * This function sets a random value for the sequence number that will be sent to the
+ * receiver. The first data packet carries this sequence number. This is used
+ * to ensure that the sender and receiver are in sync with each other and that
+ * the packets are not duplicated or lost. While the sequence number could always
+ * be set to 0, this would make the protocol more susceptible to attacks and would not be
+ * as robust as using a random sequence number.
+ *
+ * If a SYN-ACK packet is not received within a certain timeout, the SYN packet is resent.
+ * Additionally, this function will initiate an exponential backoff mechanism and double
+ * the timeout until a maximum threshold is reached.
+ *
+ * The SYN also announces the amount of data in each packet and, if it is known,
+ * the size of the transfer, so the receiver can place each packet in the file
+ * as soon as it arrives and preallocate the file. It also carries a random
+ * connection ID, which a receiver serving many senders tells transfers apart by.
+ *
+ * @param sockfd The socket file descriptor
+ * @param addr The address of the receiver
+ * @param addrlen The length of the address
+ * @param transferSize The number of bytes that will be sent, or 0 if not known in advance
+ * @return Void
+ */
+void establish_connection(int sockfd, struct sockaddr_in *addr, socklen_t addrlen, unsigned long long transferSize)
+{
+    struct timeval tv;
+    int timeout = SYN_ACK_DEFAULT_TIMEOUT_MILLISEC;
+    tv.tv_sec = 0;
+
+    // Initialize sequence number. It is kept across retries so that the receiver
+    // learns the same starting point no matter which SYN it answers.
+    struct Syn syn;
+    memset(&syn, 0, sizeof(syn));
+    srand(time(NULL));
+    uint32_t sequenceNumber = rand();
+    _sequenceNumber = sequenceNumber;
+    _initialSequenceNumber = sequenceNumber;
+    _baseSequenceNumber = sequenceNumber;
+    _receiveWindowAck = sequenceNumber;
+    _receiveWindowEnd = sequenceNumber + REORDER_BUFFER_SIZE;
+    syn.sequenceNumber = htonl(sequenceNumber);
+    syn.packetDataSize = htonl(_packetDataSize);
+    syn.transferSize = htobe64(transferSize);
+
+    // Senders started at the same time would share a seed, so the connection ID comes from the kernel
+    while (_connectionId == 0)
+    {
+        if (getrandom(&_connectionId, sizeof(_connectionId), 0) < 0 && errno != EINTR)
+        {
+            perror("getrandom");
+            exit(1);
+        }
+    }
+    syn.connectionId = htonl(_connectionId);
+    syn.transferId = htonl(_transferId);
+
+    while (TRUE)
+    {
+        // Set timeout for SYN-ACK packet
+        tv.tv_usec = timeout;
+
+        if (setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0)
+        {
+            perror("timeout");
+            exit(1);
+        }
+
+        // Send SYN packet and delay before checking for SYN-ACK
+        sendto(sockfd, &syn, sizeof(struct Syn), 0, (struct sockaddr *)addr, addrlen);
+        usleep(timeout);
+
+        struct SynAck syn_ack;
+        ssize_t recv_size = recvfrom(sockfd, &syn_ack, sizeof(struct SynAck), 0, (struct sockaddr *)addr, &addrlen);
+
+        if (recv_size == sizeof(struct SynAck) && ntohl(syn_ack.ackNumber) == sequenceNumber + 1)
+        {
+            // Send ACK packet
+            struct Ack ack;
+            ack.ackNumber = htonl(ntohl(syn_ack.sequenceNumber) + 1);
+            ack.cumulativeAck = htonl(sequenceNumber);
+            ack.sackCount = 0;
+            ack.window = 0;
+
+            sendto(sockfd, &ack, ACK_HEADER_SIZE, 0, (struct sockaddr *)addr, addrlen);
+
+            return;
+        }
+
+        else if (recv_size == -1)
+        {
+            // No response from receiver. Update timeout before resending SYN packet.
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+            {
+                if (timeout < SYN_ACK_MAX_TIMEOUT_MILLISEC)
+                {
+                    timeout *= 2;
+                }
+
+                continue;
+            }
+            else
+            {
+                perror("recvfrom");
+                exit(1);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Returns the current time in nanoseconds.
+ *
+ * The time is read from the monotonic clock so that it is not affected by
+ * changes to the system time while a transfer is in progress.
+ *
+ * @return The current time, in nanoseconds
+ */
+unsigned long long get_time_nsec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (unsigned long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief Returns the current time in microseconds.
+ *
+ * @return The current time, in microseconds
+ */
+unsigned long long get_time_usec()
+{
+    return get_time_nsec() / 1000;
+}
+
+/**
+ * @brief Waits until an ACK arrives or the timeout expires.
+ *
+ * Uses ppoll, whose timeout is backed by a high-resolution timer, so short
+ * waits for the pacer are accurate to a few microseconds rather than to a
+ * scheduler tick.
+ *
+ * @param sockfd The socket file descriptor
+ * @param timeout The timeout, in nanoseconds
+ * @return Void
+ */
+void wait_for_ack(int sockfd, unsigned long long timeout)
+{
+    struct pollfd pfd;
+    pfd.fd = sockfd;
+    pfd.events = POLLIN;
+
+    struct timespec ts;
+    ts.tv_sec = timeout / 1000000000;
+    ts.tv_nsec = timeout % 1000000000;
+
+    if (ppoll(&pfd, 1, &ts, NULL) < 0 && errno != EINTR)
+    {
+        perror("ppoll");
+        exit(1);
+    }
+}
+
+/**
+ * @brief Returns the rate to pace packets at.
+ *
+ * A fixed rate from the command line takes precedence. Otherwise the rate is
+ * the one set by the congestion control algorithm, if any. If pacing was asked
+ * for and the algorithm sets no rate, the congestion window is spread over a
+ * smoothed round-trip time, with a gain so the window can still grow.
+ *
+ * @return The rate, in bytes per second, or 0 to not pace
+ */
+unsigned long long get_pacing_rate()
+{
+    if (_fixedPacingRate != 0)
+    {
+        return _fixedPacingRate;
+    }
+
+    if (_congestion.pacingRate != 0)
+    {
+        return _congestion.pacingRate;
+    }
+
+    if (!_pacing || _smoothedRtt == 0)
+    {
+        return 0;
+    }
+
+    double gain = _congestion.cwnd < _congestion.ssthresh ? PACING_SLOW_START_GAIN : PACING_CONGESTION_AVOIDANCE_GAIN;
+    return gain * _congestion.cwnd * MAX_PACKET_SIZE * 1000000 / _smoothedRtt;
+}
+
+/**
+ * @brief Looks up the send state of a packet in the window.
+ *
+ * @param sequenceNumber The sequence number of the packet
+ * @return The window entry used by the packet
+ */
+struct PacketState *get_packet_state(uint32_t sequenceNumber)
+{
+    return &_window[(sequenceNumber - _initialSequenceNumber) % _windowSize];
+}
+
+/**
+ * @brief Takes the next chunk of the file into a window entry.
+ *
+ * Takes up to _packetDataSize bytes, but never more than the bytes left to
+ * transfer, and fills in the packet header, with the connection ID as its
+ * first extension. The packet is marked as the last packet once the end of
+ * the transfer (or the end of the file) is reached.
+ * A packet of a sub-flow also carries the offset of its data in the file,
+ * and is the last once the sub-flow has no more of the file to send.
+ * The datagram is only as long as the header and the data. The packet's
+ * data points into the mapping, or into a chunk read ahead by the reader
+ * thread, instead of being copied; the chunk the entry held before is
+ * given back first.
+ *
+ * @param source The file being transferred
+ * @param state The window entry to fill
+ * @param sequenceNumber The sequence number to give the packet
+ * @return The number of bytes of file data placed in the packet
+ */
+int prepare_packet(struct FileSource *source, struct PacketState *state, uint32_t sequenceNumber)
+{
+    // The entry's old data is no longer needed for retransmissions
+    if (state->data != NULL)
+    {
+        source_release(source);
+    }
+
+    size_t bytesRead = source_read(source, &state->data);
+
+    struct Header header;
+    header.sequenceNumber = sequenceNumber;
+    header.messageLength = bytesRead;
+    if (source->done)
+    {
+        header.lastPacket = TRUE;
+    }
+    else
+    {
+        header.lastPacket = FALSE;
+    }
+
+    header_encode(&header, state->header);
+
+    uint32_t connectionId = htonl(_connectionId);
+    int headerLength = header_add_extension(state->header, HEADER_EXTENSION_CONNECTION_ID, &connectionId,
+                                            sizeof(connectionId));
+
+    if (headerLength >= 0 && source->stripes != NULL)
+    {
+        uint64_t offset = htobe64(source->position);
+        headerLength = header_add_extension(state->header, HEADER_EXTENSION_OFFSET, &offset, sizeof(offset));
+    }
+
+    // A packet without all its extensions would be misread by the receiver
+    if (headerLength < 0)
+    {
+        fprintf(stderr, "packet header has no room for its extensions\n");
+        exit(1);
+    }
+
+    state->headerLength = headerLength;
+    state->sequenceNumber = sequenceNumber;
+    state->length = state->headerLength + bytesRead;
+    state->lastPacket = header.lastPacket;
+    state->acked = FALSE;
+    state->lost = FALSE;
+    state->retries = 0;
+    state->fastRetransmitted = FALSE;
+
+    return bytesRead;
+}
+
+/**
+ * @brief Checks whether the kernel supports UDP segmentation offload (GSO).
+ *
+ * Kernels without it would send a super-buffer as a single oversized datagram,
+ * so GSO is only used if the UDP_SEGMENT option is known.
+ *
+ * @param sockfd The socket file descriptor
+ * @return Void
+ */
+void probe_gso(int sockfd)
+{
+    int segmentSize = 0;
+
+    if (_gso && setsockopt(sockfd, SOL_UDP, UDP_SEGMENT, &segmentSize, sizeof(segmentSize)) < 0)
+    {
+        _gso = FALSE;
+    }
+}
+
+/**
+ * @brief Turns on MSG_ZEROCOPY for the socket, if it was asked for.
+ *
+ * If the kernel does not support SO_ZEROCOPY, packets are copied as usual.
+ *
+ * @param sockfd The socket file descriptor
+ * @return Void
+ */
+void enable_zerocopy(int sockfd)
+{
+    int enable = 1;
+
+    if (_zerocopy && setsockopt(sockfd, SOL_SOCKET, SO_ZEROCOPY, &enable, sizeof(enable)) < 0)
+    {
+        fprintf(stderr, "MSG_ZEROCOPY not supported (%s), copying packets\n", strerror(errno));
+        _zerocopy = FALSE;
+    }
+}
+
+/**
+ * @brief Reads the MSG_ZEROCOPY completion notifications waiting on the socket's error queue.
+ *
+ * Each notification covers a range of send IDs. _zerocopyOldest then moves
+ * past every send that has completed.
+ *
+ * @param sockfd The socket file descriptor
+ * @return Void
+ */
+void reap_completions(int sockfd)
+{
+    while (TRUE)
+    {
+        union
+        {
+            char buffer[CMSG_SPACE(sizeof(struct sock_extended_err) + sizeof(struct sockaddr_in))];
+            struct cmsghdr align;
+        } control;
+
+        struct msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_control = control.buffer;
+        message.msg_controllen = sizeof(control.buffer);
+
+        if (recvmsg(sockfd, &message, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+            {
+                break;
+            }
+
+            perror("recvmsg");
+            exit(1);
+        }
+
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message); cmsg != NULL; cmsg = CMSG_NXTHDR(&message, cmsg))
+        {
+            if (cmsg->cmsg_level != SOL_IP || cmsg->cmsg_type != IP_RECVERR)
+            {
+                continue;
+            }
+
+            struct sock_extended_err error;
+            memcpy(&error, CMSG_DATA(cmsg), sizeof(error));
+            if (error.ee_origin != SO_EE_ORIGIN_ZEROCOPY || error.ee_errno != 0)
+            {
+                continue;
+            }
+
+            // The range runs from ee_info to ee_data, inclusive
+            for (uint32_t id = error.ee_info; id != error.ee_data + 1; id++)
+            {
+                _zerocopyDone[id % ZEROCOPY_MAX_PENDING] = TRUE;
+            }
+
+            if (error.ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+            {
+                _zerocopyCopied += error.ee_data - error.ee_info + 1;
+            }
+        }
+    }
+
+    while (_zerocopyOldest != _zerocopyNext && _zerocopyDone[_zerocopyOldest % ZEROCOPY_MAX_PENDING])
+    {
+        _zerocopyDone[_zerocopyOldest % ZEROCOPY_MAX_PENDING] = FALSE;
+        _zerocopyOldest++;
+    }
+}
+
+/**
+ * @brief Waits until a MSG_ZEROCOPY send, and every send before it, has completed.
+ *
+ * @param sockfd The socket file descriptor
+ * @param id The ID of the send
+ * @return Void
+ */
+void wait_for_completion(int sockfd, uint32_t id)
+{
+    reap_completions(sockfd);
+
+    while (!SEQ_LT(id, _zerocopyOldest))
+    {
+        // Notifications on the error queue are reported as POLLERR, which needs no event bits
+        struct pollfd pfd;
+        pfd.fd = sockfd;
+        pfd.events = 0;
+
+        if (poll(&pfd, 1, -1) < 0 && errno != EINTR)
+        {
+            perror("poll");
+            exit(1);
+        }
+
+        reap_completions(sockfd);
+    }
+}
+
+/**
+ * @brief Checks whether the kernel may still be reading a packet from an earlier MSG_ZEROCOPY send.
+ *
+ * @param state The window entry of the packet
+ * @return TRUE if the window entry must not be changed yet, FALSE otherwise
+ */
+int zerocopy_pending(struct PacketState *state)
+{
+    return state->zerocopyPending && !SEQ_LT(state->zerocopyId, _zerocopyOldest);
+}
+
+/**
+ * @brief Builds the sendmmsg messages for the queued packets, starting at the given packet.
+ *
+ * With GSO, consecutive packets go in one message, as a GSO super-buffer split
+ * by the kernel into one datagram per packet. Every packet of a super-buffer
+ * but the last must have the same length, which becomes the segment size.
+ *
+ * @param first The index of the first packet in _sendBatchPackets to send
+ * @param addr The address of the receiver
+ * @return The number of messages built
+ */
+int build_messages(int first, struct sockaddr_in *addr)
+{
+    int messageCount = 0;
+
+    for (int i = first; i < _sendBatchCount; messageCount++)
+    {
+        size_t segmentSize = _sendBatchPackets[i]->length;
+        int maxSegments = 1;
+        if (_gso)
+        {
+            maxSegments = GSO_MAX_SIZE / segmentSize < GSO_MAX_SEGMENTS ? GSO_MAX_SIZE / segmentSize : GSO_MAX_SEGMENTS;
+        }
+
+        // A MSG_ZEROCOPY send pins every page it refers to, and one send may only refer to so many
+        if (_zerocopy)
+        {
+            int fragments = 2 + (segmentSize + ZEROCOPY_PAGE_SIZE - 1) / ZEROCOPY_PAGE_SIZE;
+            if (ZEROCOPY_MAX_FRAGMENTS / fragments < maxSegments)
+            {
+                maxSegments = ZEROCOPY_MAX_FRAGMENTS / fragments > 0 ? ZEROCOPY_MAX_FRAGMENTS / fragments : 1;
+            }
+        }
+
+        int segments = 1;
+        while (segments < maxSegments && i + segments < _sendBatchCount &&
+               _sendBatchPackets[i + segments - 1]->length == segmentSize &&
+               _sendBatchPackets[i + segments]->length <= segmentSize)
+        {
+            segments++;
+        }
+
+        struct mmsghdr *message = &_sendBatch[messageCount];
+        memset(message, 0, sizeof(*message));
+        message->msg_hdr.msg_name = addr;
+        message->msg_hdr.msg_namelen = sizeof(*addr);
+        message->msg_hdr.msg_iov = &_sendBatchData[i * 2];
+        message->msg_hdr.msg_iovlen = segments * 2;
+
+        if (segments > 1)
+        {
+            message->msg_hdr.msg_control = _sendBatchControl[messageCount].buffer;
+            message->msg_hdr.msg_controllen = sizeof(_sendBatchControl[messageCount].buffer);
+
+            struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message->msg_hdr);
+            cmsg->cmsg_level = SOL_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+
+            uint16_t size = segmentSize;
+            memcpy(CMSG_DATA(cmsg), &size, sizeof(size));
+        }
+
+        i += segments;
+    }
+
+    return messageCount;
+}
+
+/**
+ * @brief Queues the multishot receive of ACKs into the io_uring ACK buffers.
+ *
+ * @param sockfd The socket file descriptor
+ * @return Void
+ */
+void post_ack_receive(int sockfd)
+{
+    uring_prep_recv_multishot(uring_get_sqe(&_uring), sockfd, &_uringAcks, 1);
+    _uringReceiving = TRUE;
+}
+
+/**
+ * @brief Sets up the io_uring engine, if it was asked for.
+ *
+ * The ACK receive is queued and submitted along with the first sends. If the
+ * kernel has no usable io_uring, or no buffer rings, the sender makes system
+ * calls instead.
+ *
+ * @param sockfd The socket file descriptor
+ * @return Void
+ */
+void start_uring(int sockfd)
+{
+    if (!_useUring)
+    {
+        return;
+    }
+
+    if (uring_init(&_uring, URING_ENTRIES) < 0)
+    {
+        fprintf(stderr, "io_uring not available (%s), using system calls\n", strerror(errno));
+        _useUring = FALSE;
+        return;
+    }
+
+    if (uring_buffers_init(&_uring, &_uringAcks, 0, URING_ACK_BUFFERS, MAX_ACK_SIZE) < 0)
+    {
+        fprintf(stderr, "io_uring buffer rings not available (%s), using system calls\n", strerror(errno));
+        uring_exit(&_uring);
+        _useUring = FALSE;
+        return;
+    }
+
+    post_ack_receive(sockfd);
+}
+
+/**
+ * @brief Consumes every io_uring completion that has arrived.
+ *
+ * Received ACKs are put aside in _uringReadyAcks for checkAck. A send that
+ * failed is treated like a packet dropped by the network, except that a GSO
+ * super-buffer the kernel rejects turns GSO off for the rest of the transfer.
+ *
+ * @return Void
+ */
+void reap_uring()
+{
+    struct io_uring_cqe *cqe;
+
+    while ((cqe = uring_peek(&_uring)) != NULL)
+    {
+        uint64_t userData = cqe->user_data;
+        int result = cqe->res;
+        unsigned flags = cqe->flags;
+        uring_advance(&_uring);
+
+        if (userData == 0)
+        {
+            if (result >= 0 || result == -ENOBUFS || result == -EAGAIN)
+            {
+                continue;
+            }
+
+            if (_gso && (result == -EINVAL || result == -EIO))
+            {
+                if (_verbose)
+                {
+                    fprintf(stderr, "GSO rejected (%s), sending packets individually\n", strerror(-result));
+                }
+                _gso = FALSE;
+                continue;
+            }
+
+            fprintf(stderr, "sendmsg: %s\n", strerror(-result));
+            exit(1);
+        }
+
+        if (flags & IORING_CQE_F_BUFFER)
+        {
+            _uringReadyAcks[_uringReadyCount] = flags >> IORING_CQE_BUFFER_SHIFT;
+            _uringReadyLengths[_uringReadyCount] = result;
+            _uringReadyCount++;
+        }
+
+        // The receive ends when it runs out of buffers, and is queued again by checkAck
+        if (!(flags & IORING_CQE_F_MORE))
+        {
+            _uringReceiving = FALSE;
+
+            if (result < 0 && result != -ENOBUFS && result != -EINTR && result != -EAGAIN && result != -ECANCELED)
+            {
+                fprintf(stderr, "recv: %s\n", strerror(-result));
+                exit(1);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Sends every packet queued by send_packet through io_uring.
+ *
+ * One send request is queued per message, and they are all submitted with a
+ * single io_uring_enter call, together with the ACK receive if it is waiting
+ * to be submitted. The messages may be rebuilt as soon as they are submitted.
+ *
+ * @param sockfd The socket file descriptor
+ * @param addr The address of the receiver
+ * @return Void
+ */
+void flush_packets_uring(int sockfd, struct sockaddr_in *addr)
+{
+    int messageCount = build_messages(0, addr);
+
+    for (int i = 0; i < messageCount; i++)
+    {
+        uring_prep_sendmsg(uring_get_sqe(&_uring), sockfd, &_sendBatch[i].msg_hdr, 0, 0);
+
+        int segments = _sendBatch[i].msg_hdr.msg_iovlen / 2;
+        if (segments > 1)
+        {
+            _gsoBuffers++;
+            _gsoSegments += segments;
+        }
+    }
+
+    uring_submit(&_uring);
+    reap_uring();
+
+    _packetsSent += _sendBatchCount;
+    _sendBatchCount = 0;
+}
+
+/**
+ * @brief Sends every packet queued by send_packet.
+ *
+ * The packets go out with as few sendmmsg calls as possible, normally one,
+ * grouped into GSO super-buffers where possible. If the kernel rejects a
+ * super-buffer (for example, because the route's device cannot segment it),
+ * GSO is turned off and the remaining packets are sent one datagram each.
+ * With the io_uring engine, the packets go out through flush_packets_uring.
+ *
+ * @param sockfd The socket file descriptor
+ * @param addr The address of the receiver
+ * @return Void
+ */
+void flush_packets(int sockfd, struct sockaddr_in *addr)
+{
+    if (_useUring)
+    {
+        flush_packets_uring(sockfd, addr);
+        return;
+    }
+
+    int sent = 0;
+    int flags = _zerocopy ? MSG_ZEROCOPY : 0;
+
+    while (sent < _sendBatchCount)
+    {
+        int messageCount = build_messages(sent, addr);
+
+        // Every message takes a completion ID, so make room for them all
+        if (flags & MSG_ZEROCOPY)
+        {
+            uint32_t pending = _zerocopyNext - _zerocopyOldest;
+            if (pending + messageCount > ZEROCOPY_MAX_PENDING)
+            {
+                wait_for_completion(sockfd, _zerocopyOldest + (pending + messageCount - ZEROCOPY_MAX_PENDING) - 1);
+            }
+        }
+
+        int result = sendmmsg(sockfd, _sendBatch, messageCount, flags);
+        if (result < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            // Too much memory is pinned by sends in progress, so wait for one or copy this time
+            if ((flags & MSG_ZEROCOPY) && errno == ENOBUFS)
+            {
+                if (_zerocopyOldest != _zerocopyNext)
+                {
+                    wait_for_completion(sockfd, _zerocopyOldest);
+                }
+                else
+                {
+                    flags = 0;
+                }
+                continue;
+            }
+
+            if (_gso && (errno == EINVAL || errno == EIO))
+            {
+                if (_verbose)
+                {
+                    fprintf(stderr, "GSO rejected (%s), sending packets individually\n", strerror(errno));
+                }
+                _gso = FALSE;
+                continue;
+            }
+
+            perror("sendmmsg");
+            exit(1);
+        }
+
+        for (int i = 0; i < result; i++)
+        {
+            int segments = _sendBatch[i].msg_hdr.msg_iovlen / 2;
+
+            if (flags & MSG_ZEROCOPY)
+            {
+                for (int j = sent; j < sent + segments; j++)
+                {
+                    _sendBatchPackets[j]->zerocopyId = _zerocopyNext;
+                    _sendBatchPackets[j]->zerocopyPending = TRUE;
+                }
+                _zerocopyNext++;
+            }
+
+            if (segments > 1)
+            {
+                _gsoBuffers++;
+                _gsoSegments += segments;
+            }
+            sent += segments;
+        }
+        _sendCalls++;
+    }
+
+    _packetsSent += _sendBatchCount;
+    _sendBatchCount = 0;
+}
+
+/**
+ * @brief Sends (or resends) a packet in the window to the receiver.
+ *
+ * The packet is queued and sent along with the packets around it by
+ * flush_packets, which is called once SEND_BATCH_SIZE packets are queued.
+ * The caller must call flush_packets once it has nothing more to send, and
+ * must not change the packet until then.
+ *
+ * Records the time of the transmission so that the packet can be retransmitted
+ * if it is not acknowledged in time, and counts the packet as in flight. The
+ * delivery state at the time is also recorded for sampling the delivery rate.
+ *
+ * @param sockfd The socket file descriptor
+ * @param addr The address of the receiver
+ * @param state The window entry of the packet to send
+ * @return Void
+ */
+void send_packet(int sockfd, struct sockaddr_in *addr, struct PacketState *state)
+{
+    struct iovec *data = &_sendBatchData[_sendBatchCount * 2];
+    data[0].iov_base = state->header;
+    data[0].iov_len = state->headerLength;
+    data[1].iov_base = (void *)state->data;
+    data[1].iov_len = state->length - state->headerLength;
+    _sendBatchPackets[_sendBatchCount] = state;
+
+    if (++_sendBatchCount == SEND_BATCH_SIZE)
+    {
+        flush_packets(sockfd, addr);
+    }
+
+    state->sentTime = get_time_usec();
+
+    // The delivery rate of a flight is measured from its first packet
+    if (_packetsInFlight == 0)
+    {
+        _firstSentTime = state->sentTime;
+        _deliveredTime = state->sentTime;
+    }
+
+    state->firstSentTime = _firstSentTime;
+    state->delivered = _delivered;
+    state->deliveredTime = _deliveredTime;
+    state->appLimited = _appLimited != 0;
+
+    if (state->lost)
+    {
+        state->lost = FALSE;
+        _packetsLost--;
+    }
+    _packetsInFlight++;
+}
+
+/**
+ * @brief Marks a packet in flight as lost.
+ *
+ * The packet stops counting as in flight and waits to be retransmitted.
+ *
+ * @param state The window entry of the packet
+ * @return Void
+ */
+void mark_lost(struct PacketState *state)
+{
+    state->lost = TRUE;
+    _packetsLost++;
+    _packetsInFlight--;
+}
+
+/**
+ * @brief Finds the oldest packet waiting to be retransmitted.
+ *
+ * @return The window entry of the packet, or NULL if no packet is lost
+ */
+struct PacketState *get_next_lost()
+{
+    if (_packetsLost == 0)
+    {
+        return NULL;
+    }
+
+    for (uint32_t seq = _baseSequenceNumber; seq != _sequenceNumber; seq++)
+    {
+        struct PacketState *state = get_packet_state(seq);
+        if (state->lost)
+        {
+            return state;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Updates the retransmission timeout with a new round-trip time sample.
+ *
+ * Uses the Jacobson/Karels estimator from RFC 6298: the smoothed round-trip
+ * time and its variation are exponentially weighted moving averages (with
+ * gains of 1/8 and 1/4), and the timeout is SRTT + 4 * RTTVAR, kept between
+ * MIN_TIMEOUT and _maxTimeout.
+ *
+ * Samples must only be taken from packets that were never retransmitted
+ * (Karn's rule), since an ACK for a retransmitted packet may belong to any of
+ * its transmissions.
+ *
+ * @param rtt The measured round-trip time, in microseconds
+ * @return Void
+ */
+void update_rtt(unsigned long long rtt)
+{
+    if (_minRtt == 0 || rtt < _minRtt)
+    {
+        _minRtt = rtt;
+    }
+
+    if (_smoothedRtt == 0)
+    {
+        _smoothedRtt = rtt;
+        _rttVariation = rtt / 2;
+    }
+    else
+    {
+        unsigned long long difference = _smoothedRtt > rtt ? _smoothedRtt - rtt : rtt - _smoothedRtt;
+
+        _rttVariation = (3 * _rttVariation + difference) / 4;
+        _smoothedRtt = (7 * _smoothedRtt + rtt) / 8;
+    }
+
+    _retransmissionTimeout = _smoothedRtt + 4 * _rttVariation;
+
+    if (_retransmissionTimeout < MIN_TIMEOUT)
+    {
+        _retransmissionTimeout = MIN_TIMEOUT;
+    }
+    if (_retransmissionTimeout > _maxTimeout)
+    {
+        _retransmissionTimeout = _maxTimeout;
+    }
+}
+
+/**
+ * @brief Returns the time at which a packet should be retransmitted.
+ *
+ * The timeout starts at the current retransmission timeout and doubles every
+ * time the packet times out, up to _maxTimeout.
+ *
+ * @param state The window entry of the packet
+ * @return The retransmission deadline, in microseconds
+ */
+unsigned long long get_retransmit_time(struct PacketState *state)
+{
+    unsigned long long timeout = _retransmissionTimeout;
+
+    for (int i = 0; i < state->retries && timeout < _maxTimeout; i++)
+    {
+        timeout *= 2;
+    }
+
+    if (timeout > _maxTimeout)
+    {
+        timeout = _maxTimeout;
+    }
+
+    return state->sentTime + timeout;
+}
+
+/**
+ * @brief Returns how long to wait for an ACK before a packet must be retransmitted.
+ *
+ * @return The time until the earliest retransmission deadline in the window, in microseconds
+ */
+unsigned long long get_ack_timeout()
+{
+    unsigned long long now = get_time_usec();
+    unsigned long long timeout = _maxTimeout;
+
+    for (uint32_t seq = _baseSequenceNumber; seq != _sequenceNumber; seq++)
+    {
+        struct PacketState *state = get_packet_state(seq);
+        if (state->acked || state->lost)
+        {
+            continue;
+        }
+
+        unsigned long long deadline = get_retransmit_time(state);
+        if (deadline <= now)
+        {
+            return 0;
+        }
+
+        if (deadline - now < timeout)
+        {
+            timeout = deadline - now;
+        }
+    }
+
+    return timeout;
+}
+
+/**
+ * @brief Counts a newly acknowledged packet as delivered and updates the delivery rate sample.
+ *
+ * The sample is taken from the most recently sent packet acknowledged, as that
+ * gives the most recent view of the path.
+ *
+ * @param state The window entry of the packet
+ * @param now The time the packet was acknowledged, in microseconds
+ * @param rate The delivery rate sample being built
+ * @return Void
+ */
+void update_delivered(struct PacketState *state, unsigned long long now, struct RateSample *rate)
+{
+    _delivered += state->length;
+    _deliveredTime = now;
+
+    if (rate->priorTime == 0 || state->delivered >= rate->priorDelivered)
+    {
+        rate->priorDelivered = state->delivered;
+        rate->priorTime = state->deliveredTime;
+        rate->appLimited = state->appLimited;
+        rate->sendElapsed = state->sentTime - state->firstSentTime;
+        rate->ackElapsed = _deliveredTime - state->deliveredTime;
+
+        // The next sample's send interval starts at this packet
+        _firstSentTime = state->sentTime;
+    }
+}
+
+/**
+ * @brief Completes the delivery rate sample once every ACK has been processed.
+ *
+ * The interval is the longer of the send and ACK intervals, since the slower of
+ * the two bounds the rate the path delivered at. Samples over less than a
+ * minimum round-trip time are discarded, as ACK compression makes them too high.
+ *
+ * @param rate The delivery rate sample
+ * @return Void
+ */
+void generate_rate_sample(struct RateSample *rate)
+{
+    if (_appLimited != 0 && _delivered > _appLimited)
+    {
+        _appLimited = 0;
+    }
+
+    if (rate->priorTime == 0)
+    {
+        return;
+    }
+
+    rate->delivered = _delivered - rate->priorDelivered;
+    rate->interval = rate->sendElapsed > rate->ackElapsed ? rate->sendElapsed : rate->ackElapsed;
+
+    if (rate->interval < _minRtt)
+    {
+        rate->interval = 0;
+    }
+}
+
+/**
+ * @brief Marks a range of packets as acknowledged.
+ *
+ * The range is clipped to the packets currently in the window, so
+ * acknowledgments for packets that have already left the window are ignored.
+ *
+ * @param start The sequence number of the first packet in the range
+ * @param end The sequence number just after the last packet in the range
+ * @param now The time the ACK arrived, in microseconds
+ * @param rate The delivery rate sample being built
+ * @return The number of packets newly acknowledged
+ */
+int mark_acked(uint32_t start, uint32_t end, unsigned long long now, struct RateSample *rate)
+{
+    int newlyAcked = 0;
+
+    if (SEQ_LT(start, _baseSequenceNumber))
+    {
+        start = _baseSequenceNumber;
+    }
+    if (SEQ_LT(_sequenceNumber, end))
+    {
+        end = _sequenceNumber;
+    }
+
+    for (uint32_t seq = start; SEQ_LT(seq, end); seq++)
+    {
+        struct PacketState *state = get_packet_state(seq);
+        if (state->acked)
+        {
+            continue;
+        }
+
+        state->acked = TRUE;
+        newlyAcked++;
+        update_delivered(state, now, rate);
+
+        // A packet considered lost may still arrive, in which case it no longer needs retransmitting
+        if (state->lost)
+        {
+            state->lost = FALSE;
+            _packetsLost--;
+        }
+        else
+        {
+            _packetsInFlight--;
+        }
+    }
+
+    return newlyAcked;
+}
+
+/**
+ * @brief Processes an ACK packet from the receiver.
+ *
+ * Each ACK acknowledges the packet that triggered it, every packet before
+ * its cumulative acknowledgment, and every packet in its SACK blocks. Stray
+ * handshake packets are ignored.
+ *
+ * If the packet that triggered the ACK was newly acknowledged and has never been
+ * retransmitted, its round-trip time is used to update the retransmission timeout.
+ * The receiver's window is taken from the ACK unless a newer ACK has arrived already.
+ *
+ * @param packet The ACK, in network byte order
+ * @param bytesReceived The length of the ACK packet
+ * @param event Filled in with the round-trip time sample and the delivery rate sample
+ * @return The number of packets newly acknowledged
+ */
+int process_ack(const struct Ack *packet, int bytesReceived, struct AckEvent *event)
+{
+    unsigned long long now = get_time_usec();
+
+    // A resent SYN-ACK is shorter than an ACK
+    if (bytesReceived < ACK_HEADER_SIZE)
+    {
+        return 0;
+    }
+
+    struct Ack ack;
+    ack.ackNumber = ntohl(packet->ackNumber);
+    ack.cumulativeAck = ntohl(packet->cumulativeAck);
+    ack.sackCount = ntohl(packet->sackCount);
+    ack.window = ntohl(packet->window);
+    if (ack.sackCount > MAX_SACK_BLOCKS || bytesReceived < ACK_HEADER_SIZE + ack.sackCount * sizeof(struct SackBlock))
+    {
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < ack.sackCount; i++)
+    {
+        ack.sacks[i].start = ntohl(packet->sacks[i].start);
+        ack.sacks[i].end = ntohl(packet->sacks[i].end);
+    }
+
+    // Take a round-trip time sample, following Karn's rule
+    if (!SEQ_LT(ack.ackNumber, _baseSequenceNumber) && SEQ_LT(ack.ackNumber, _sequenceNumber))
+    {
+        struct PacketState *state = get_packet_state(ack.ackNumber);
+        if (!state->acked && state->retries == 0 && !state->fastRetransmitted)
+        {
+            event->rtt = now - state->sentTime;
+            update_rtt(event->rtt);
+        }
+    }
+
+    if (!SEQ_LT(ack.cumulativeAck, _receiveWindowAck))
+    {
+        _receiveWindowAck = ack.cumulativeAck;
+        _receiveWindowEnd = ack.cumulativeAck + ack.window;
+        _receiveWindowTime = now;
+        if (ack.window > 0)
+        {
+            _windowProbes = 0;
+        }
+    }
+
+    int newlyAcked = 0;
+    newlyAcked += mark_acked(_baseSequenceNumber, ack.cumulativeAck, now, &event->rate);
+    newlyAcked += mark_acked(ack.ackNumber, ack.ackNumber + 1, now, &event->rate);
+
+    for (uint32_t i = 0; i < ack.sackCount; i++)
+    {
+        newlyAcked += mark_acked(ack.sacks[i].start, ack.sacks[i].end, now, &event->rate);
+    }
+
+    return newlyAcked;
+}
+
+/**
+ * @brief Returns how long to wait before probing a closed receive window.
+ *
+ * The receiver sends a window update once it has room again, so a probe is
+ * only needed if the update is lost. One packet is then sent into the closed
+ * window once no ACK has changed the window for a retransmission timeout,
+ * doubled for every probe already sent, up to _maxTimeout.
+ *
+ * @return The time to wait, in microseconds, or 0 if a probe may be sent now
+ */
+unsigned long long get_probe_delay()
+{
+    unsigned long long timeout = _retransmissionTimeout;
+    for (int i = 0; i < _windowProbes && timeout < _maxTimeout; i++)
+    {
+        timeout *= 2;
+    }
+    if (timeout > _maxTimeout)
+    {
+        timeout = _maxTimeout;
+    }
+
+    unsigned long long deadline = _receiveWindowTime + timeout;
+    unsigned long long now = get_time_usec();
+
+    return deadline > now ? deadline - now : 0;
+}
+
+/**
+ * @brief Checks for ACK packets from the receiver.
+ *
+ * This function processes every ACK packet that has already arrived without
+ * blocking: the ones read from the socket, or with the io_uring engine, the
+ * ones its receive has completed with (each buffer is then given back).
+ * The packets acknowledged also give a delivery rate sample.
+ *
+ * @param sockfd The socket file descriptor
+ * @param event Filled in with the most recent round-trip time sample and the delivery rate sample
+ * @return The number of packets newly acknowledged
+ */
+int checkAck(int sockfd, struct AckEvent *event)
+{
+    int newlyAcked = 0;
+
+    if (_useUring)
+    {
+        reap_uring();
+
+        for (int i = 0; i < _uringReadyCount; i++)
+        {
+            struct Ack *ack = (struct Ack *)uring_buffer(&_uringAcks, _uringReadyAcks[i]);
+            newlyAcked += process_ack(ack, _uringReadyLengths[i], event);
+            uring_buffer_release(&_uringAcks, _uringReadyAcks[i]);
+        }
+        _uringReadyCount = 0;
+
+        if (!_uringReceiving)
+        {
+            post_ack_receive(sockfd);
+        }
+
+        generate_rate_sample(&event->rate);
+        return newlyAcked;
+    }
+
+    while (TRUE)
+    {
+        struct Ack ack;
+
+        int bytesReceived = recvfrom(sockfd, &ack, MAX_ACK_SIZE, MSG_DONTWAIT, NULL, NULL);
+        if (bytesReceived < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+            {
+                generate_rate_sample(&event->rate);
+                return newlyAcked;
+            }
+
+            perror("recvfrom");
+            exit(1);
+        }
+
+        newlyAcked += process_ack(&ack, bytesReceived, event);
+    }
+}
+
+/**
+ * @brief Finds the packets that the SACK information shows to be lost.
+ *
+ * A packet is considered lost once DUPLICATE_THRESHOLD packets sent after it
+ * have been acknowledged, so it can be retransmitted without waiting for its
+ * timeout. During fast recovery, an ACK that moves the window forward but does
+ * not end recovery (a partial ACK, as in NewReno) also shows the oldest
+ * unacknowledged packet to be lost. Each packet is found lost this way at most
+ * once; if the retransmission is lost too, the packet's timeout recovers it.
+ *
+ * @param partialAck TRUE if the ACKs just processed moved the window forward during fast recovery
+ * @return The number of packets newly considered lost
+ */
+int detect_lost(int partialAck)
+{
+    int newlyLost = 0;
+    int ackedAfter = 0;
+
+    // Walk the window from newest to oldest, counting acknowledged packets along the way
+    for (uint32_t seq = _sequenceNumber; seq != _baseSequenceNumber;)
+    {
+        seq--;
+
+        struct PacketState *state = get_packet_state(seq);
+        if (state->acked)
+        {
+            ackedAfter++;
+        }
+        else if (!state->lost && !state->fastRetransmitted &&
+                 (ackedAfter >= DUPLICATE_THRESHOLD || (partialAck && seq == _baseSequenceNumber)))
+        {
+            state->fastRetransmitted = TRUE;
+            mark_lost(state);
+            newlyLost++;
+        }
+    }
+
+    return newlyLost;
+}
+
+/**
+ * @brief Finds every packet in flight whose timeout has expired.
+ *
+ * If a packet has already timed out _maxRetries times, the receiver is assumed
+ * to be unreachable and the transfer is abandoned.
+ *
+ * @return The number of packets that timed out
+ */
+int detect_expired()
+{
+    int expired = 0;
+    unsigned long long now = get_time_usec();
+
+    for (uint32_t seq = _baseSequenceNumber; seq != _sequenceNumber; seq++)
+    {
+        struct PacketState *state = get_packet_state(seq);
+        if (state->acked || state->lost || get_retransmit_time(state) > now)
+        {
+            continue;
+        }
+
+        if (_maxRetries > 0 && state->retries >= _maxRetries)
+        {
+            fprintf(stderr, "max timeout reached\n");
+            exit(1);
+        }
+
+        state->retries++;
+        mark_lost(state);
+        expired++;
+    }
+
+    return expired;
+}
+
+/**
+ * @brief Changes the sender's rate limit.
+ *
+ * @param rate The rate limit, in bytes per second, or 0 for no limit
+ * @return Void
+ */
+void set_rate_limit(unsigned long long rate)
+{
+    long long capacity = rate * RATE_LIMIT_BURST_TIME / 1000000000ULL;
+    if (capacity < PACING_BURST * MAX_PACKET_SIZE)
+    {
+        capacity = PACING_BURST * MAX_PACKET_SIZE;
+    }
+
+    bucket_set_rate(&_rateLimit, rate, capacity, get_time_nsec());
+}
+
+/**
+ * @brief Handles SIGUSR1 by asking the send loop to read a new rate limit.
+ *
+ * @param signum The signal number
+ * @return Void
+ */
+void handle_rate_signal(int signum)
+{
+    (void)signum;
+    _rateLimitChanged = TRUE;
+}
+
+/**
+ * @brief Reads a new rate limit, in megabits per second, from _rateLimitFile.
+ *
+ * A limit of 0 removes the limit. If the file cannot be read or holds no
+ * valid rate, the limit is left as it was, so a mistake does not end the transfer.
+ *
+ * @return Void
+ */
+void reload_rate_limit()
+{
+    FILE *file = fopen(_rateLimitFile, "r");
+    if (file == NULL)
+    {
+        perror(_rateLimitFile);
+        return;
+    }
+
+    double rateMbps;
+    int parsed = fscanf(file, "%lf", &rateMbps);
+    fclose(file);
+
+    if (parsed != 1 || rateMbps < 0)
+    {
+        fprintf(stderr, "%s: no valid rate limit, keeping the current one\n", _rateLimitFile);
+        return;
+    }
+
+    set_rate_limit(rateMbps * 1000000 / 8);
+    if (_verbose)
+    {
+        fprintf(stderr, "rate limit set to %.3f Mbit/s\n", rateMbps);
+    }
+}
+
+/**
+ * @brief Lets SIGUSR1 change the rate limit during the transfer, if a rate limit file was given.
  *
- * This variable is used to keep track of the sequence number of the packets
- * that are sent to the receiver. The sequence number is used to ensure that
- * the packets are not duplicated or lost.
+ * @return Void
  */
-int _sequenceNumber = 0;
+void watch_rate_limit()
+{
+    if (_rateLimitFile == NULL)
+    {
+        return;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handle_rate_signal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+
+    if (sigaction(SIGUSR1, &action, NULL) < 0)
+    {
+        perror("sigaction");
+        exit(1);
+    }
+}
 
 /**
- * @brief Gets the size of a file.
- *
- * This function retrieves the size of the file specified by the given filename.
+ * @brief Opens a UDP socket to send a file from.
  *
- * @param filename The path to the file whose size is to be retrieved.
- * @return The size of the file in bytes if successful, or -1 if an error occurs.
- *
- * @note If the file size exceeds the maximum value representable by a long long,
- *       the behavior of this function is undefined.
+ * @return The socket file descriptor
  */
-long long getFileSize(const char *filename)
+int open_socket()
 {
-    struct stat st;
-    if (stat(filename, &st) == 0)
-    {
-        return st.st_size;
-    }
-    else
+    int sockfd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sockfd < 0)
     {
-        return -1;
+        perror("socket");
+        exit(1);
     }
+
+    return sockfd;
 }
 
 /**
- * @brief Establishes a connection with the receiver using the 3-way handshake process.
- *
- * Sends a SYN packet to the receiver and waits for a SYN-ACK packet. Upon receiving
- * the SYN-ACK packet, the function sends a single ACK packet to the receiver and
- * assumes the connection is established.
- *
- * This function sets a random value for the sequence number that will be sent to the
- * receiver. This is used to ensure that the sender and receiver are in sync with each other
- * and that the packets are not duplicated or lost. While the sequence number could always
- * be set to 0, this would make the protocol more susceptible to attacks and would not be
- * as robust as using a random sequence number.
+ * @brief Sends a file over one connection, from the handshake until every packet has been acknowledged.
  *
- * If a SYN-ACK packet is not received within a certain timeout, the SYN packet is resent.
- * Additionally, this function will initiate an exponential backoff mechanism and double
- * the timeout until a maximum threshold is reached.
+ * This is the whole of a plain transfer, and of each sub-flow of a striped one.
  *
  * @param sockfd The socket file descriptor
  * @param addr The address of the receiver
- * @param addrlen The length of the address
+ * @param source The file, or the sub-flow's view of it
+ * @param rateLimit The most bytes to send per second, or 0 for no limit
  * @return Void
  */
-void establish_connection(int sockfd, struct sockaddr_in *addr, socklen_t addrlen)
+void send_file(int sockfd, struct sockaddr_in *addr, struct FileSource *source, unsigned long long rateLimit)
 {
-    struct timeval tv;
-    int timeout = SYN_ACK_DEFAULT_TIMEOUT_MILLISEC;
-    tv.tv_sec = 0;
-
-    while (TRUE)
+    _window = calloc(_windowSize, sizeof(struct PacketState));
+    if (_window == NULL)
     {
-        // Set timeout for SYN-ACK packet
-        tv.tv_usec = timeout;
+        perror("calloc");
+        exit(1);
+    }
 
-        if (setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0)
-        {
-            perror("timeout");
-            exit(1);
-        }
+    // Each sub-flow finds out for itself what its socket supports
+    _gso = _gsoRequested;
+    _zerocopy = _zerocopyRequested;
+    _useUring = _uringRequested;
+    probe_gso(sockfd);
+    enable_zerocopy(sockfd);
 
-        struct Syn syn;
+    // Establish connection with receiver prior to sending packets
+    establish_connection(sockfd, addr, sizeof(*addr), source->knownLength ? source->length : 0);
 
-        // Initialize sequence number
-        srand(time(NULL));
-        syn.sequenceNumber = rand();
-        _sequenceNumber = syn.sequenceNumber;
+    start_uring(sockfd);
 
-        // Send SYN packet and delay before checking for SYN-ACK
-        sendto(sockfd, &syn, sizeof(struct Syn), 0, (struct sockaddr *)addr, addrlen);
-        usleep(timeout);
+    congestion_init(&_congestion, _congestionAlgorithm, _windowSize);
+    pacer_init(&_pacer, PACING_BURST * MAX_PACKET_SIZE);
+    set_rate_limit(rateLimit);
 
-        struct SynAck syn_ack;
-        ssize_t recv_size = recvfrom(sockfd, &syn_ack, sizeof(struct SynAck), 0, (struct sockaddr *)addr, &addrlen);
+    int lastPacketQueued = FALSE;
 
-        if (recv_size > 0 && recv_size == sizeof(struct SynAck))
+    while (!lastPacketQueued || _baseSequenceNumber != _sequenceNumber)
+    {
+        if (_rateLimitChanged)
         {
-            // Send ACK packet
-            struct Ack ack;
-            ack.ackNumber = syn_ack.sequenceNumber + 1;
-
-            sendto(sockfd, &ack, sizeof(struct Ack), 0, (struct sockaddr *)addr, addrlen);
-
-            return;
+            _rateLimitChanged = FALSE;
+            reload_rate_limit();
         }
 
-        else if (recv_size == -1)
+        // Send lost packets first, then new packets, while the congestion window, the pacer and the rate limit allow
+        unsigned long long pacingDelay = 0;
+        pacer_set_rate(&_pacer, get_pacing_rate());
+
+        while (_packetsInFlight < _congestion.cwnd)
         {
-            // No response from receiver. Update timeout before resending SYN packet.
-            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            // With every packet acknowledged and no window update for a while, one packet probes a closed
+            // receive window. Its ACK brings a fresh window, and its retransmissions keep asking until there is room.
+            int windowClosed = !SEQ_LT(_sequenceNumber, _receiveWindowEnd);
+            int canSendNew = !lastPacketQueued && _sequenceNumber - _baseSequenceNumber < _windowSize &&
+                             (!windowClosed || (_sequenceNumber == _baseSequenceNumber && get_probe_delay() == 0));
+            if (_packetsLost == 0 && !canSendNew)
             {
-                if (timeout < SYN_ACK_MAX_TIMEOUT_MILLISEC)
+                // Out of data before the congestion window is full, so delivery rate samples understate the path
+                if (lastPacketQueued)
                 {
-                    timeout *= 2;
+                    _appLimited = _delivered + (unsigned long long)_packetsInFlight * MAX_PACKET_SIZE;
+                    if (_appLimited == 0)
+                    {
+                        _appLimited = 1;
+                    }
                 }
+                break;
+            }
 
-                continue;
+            unsigned long long now = get_time_nsec();
+            pacingDelay = pacer_delay(&_pacer, now);
+            unsigned long long limitDelay = bucket_delay(&_rateLimit, now);
+            if (limitDelay > pacingDelay)
+            {
+                pacingDelay = limitDelay;
             }
-            else
+            if (pacingDelay > 0)
             {
-                perror("recvfrom");
-                exit(1);
+                break;
+            }
+
+            struct PacketState *state = get_next_lost();
+            if (state == NULL)
+            {
+                state = get_packet_state(_sequenceNumber);
+
+                // The kernel may still be reading the packet that used this window entry before
+                if (zerocopy_pending(state))
+                {
+                    wait_for_completion(sockfd, state->zerocopyId);
+                }
+
+                prepare_packet(source, state, _sequenceNumber);
+                lastPacketQueued = state->lastPacket;
+
+                if (windowClosed)
+                {
+                    _windowProbes++;
+                }
+                _sequenceNumber++;
+            }
+
+            send_packet(sockfd, addr, state);
+            pacer_on_send(&_pacer, get_time_nsec(), state->length);
+            bucket_consume(&_rateLimit, state->length);
+        }
+
+        flush_packets(sockfd, addr);
+
+        // Wake up for the next ACK, the next retransmission timeout, or the next paced packet
+        unsigned long long timeout = get_ack_timeout() * 1000;
+        if (pacingDelay > 0 && pacingDelay < timeout)
+        {
+            timeout = pacingDelay;
+        }
+        if (!lastPacketQueued && _sequenceNumber == _baseSequenceNumber && !SEQ_LT(_sequenceNumber, _receiveWindowEnd) &&
+            get_probe_delay() * 1000 < timeout)
+        {
+            timeout = get_probe_delay() * 1000;
+        }
+        if (_useUring)
+        {
+            // ACKs collected while sending are already waiting to be processed
+            uring_wait(&_uring, _uringReadyCount > 0 ? 0 : timeout);
+        }
+        else
+        {
+            wait_for_ack(sockfd, timeout);
+        }
+
+        // Completions wake up the wait as well, so they are read every time
+        if (_zerocopy)
+        {
+            reap_completions(sockfd);
+        }
+
+        struct AckEvent ack;
+        memset(&ack, 0, sizeof(ack));
+        ack.ackedPackets = checkAck(sockfd, &ack);
+
+        if (ack.ackedPackets > 0)
+        {
+            // Slide the window past every acknowledged packet
+            uint32_t previousBase = _baseSequenceNumber;
+            while (_baseSequenceNumber != _sequenceNumber && get_packet_state(_baseSequenceNumber)->acked)
+            {
+                _baseSequenceNumber++;
             }
+
+            int partialAck = _congestion.state == RECOVERY_FAST && _baseSequenceNumber != previousBase;
+            ack.lostPackets = detect_lost(partialAck);
+            if (ack.lostPackets > 0)
+            {
+                congestion_on_loss(&_congestion, _sequenceNumber);
+            }
+
+            ack.cumulativeAck = _baseSequenceNumber;
+            ack.now = get_time_usec();
+            ack.packetsInFlight = _packetsInFlight;
+            ack.nextSequenceNumber = _sequenceNumber;
+            ack.delivered = _delivered;
+            congestion_on_ack(&_congestion, &ack);
+        }
+
+        if (detect_expired() > 0)
+        {
+            congestion_on_timeout(&_congestion, _sequenceNumber);
+        }
+    }
+
+    if (_verbose)
+    {
+        if (_useUring)
+        {
+            fprintf(stderr, "sent %llu packets with %llu io_uring_enter calls in all\n", _packetsSent, _uring.enterCalls);
+        }
+        else
+        {
+            fprintf(stderr, "sent %llu packets in %llu sendmmsg calls (average batch size %.2f)\n",
+                    _packetsSent, _sendCalls, _sendCalls > 0 ? (double)_packetsSent / _sendCalls : 0.0);
+        }
+        fprintf(stderr, "sent %llu packets in %llu GSO super-buffers (average %.2f segments)\n",
+                _gsoSegments, _gsoBuffers, _gsoBuffers > 0 ? (double)_gsoSegments / _gsoBuffers : 0.0);
+        fprintf(stderr, "sent %llu bytes of the file %s\n", source->offset,
+                source->map != NULL ? "from a memory mapping" : "with buffered reads");
+        if (_zerocopy)
+        {
+            fprintf(stderr, "made %u MSG_ZEROCOPY sends, %llu completed by copying\n", _zerocopyNext, _zerocopyCopied);
         }
     }
+
+    // The kernel must be done with the window and the mapped file before they are released
+    if (_zerocopy && _zerocopyOldest != _zerocopyNext)
+    {
+        wait_for_completion(sockfd, _zerocopyNext - 1);
+    }
+
+    if (_useUring)
+    {
+        uring_buffers_exit(&_uring, &_uringAcks);
+        uring_exit(&_uring);
+    }
+
+    free(_window);
 }
 
 /**
- * @brief Checks for an ACK packet from the receiver.
+ * @brief Sends a sub-flow of a striped transfer, on a thread and a socket of its own.
  *
- * This function checks for an ACK packet from the receiver. If an ACK packet is received,
- * the function checks if the sequence number of the ACK packet matches the expected sequence
- * number. If the sequence number matches, the function updates the sequence number. If the
- * sequence number does not match, the function updates the timeout and retries the packet.
+ * @param arg The sub-flow
+ * @return NULL
+ */
+void *send_sub_flow(void *arg)
+{
+    struct SubFlow *flow = arg;
+
+    int sockfd = open_socket();
+    send_file(sockfd, &flow->address, &flow->source, flow->rateLimit);
+    close(sockfd);
+
+    return NULL;
+}
+
+/**
+ * @brief Sends a mapped file over _stripes sub-flows at once.
+ *
+ * Each sub-flow is a connection of its own, from its own socket and port,
+ * so the receiver sees separate flows that the network may route apart.
+ * The file is split into a range per sub-flow, and a sub-flow that runs out
+ * steals part of the largest range left, so all of them finish at about the
+ * same time. Every sub-flow announces the same transfer ID, and every packet
+ * carries the offset of its data, so the receiver writes them all to one file.
+ * The rate limit, if any, is split evenly among the sub-flows.
  *
  * @param addr The address of the receiver
- * @param sockfd The socket file descriptor
- * @param sequenceNumber The sequence number of the most recent packet that was sent
- * @param totalBytesSent The total number of bytes sent to the receiver
- * @param bytesSentThisTime The number of bytes most recently sent to the receiver
- * @param timeout The current timeout value, in milliseconds
- * @param retries The current number of retries attempted
- * @param tv The timeval struct that specifies the socket timeout
+ * @param source The mapped file
+ * @param rateLimit The most bytes to send per second in all, or 0 for no limit
  * @return Void
  */
-void checkAck(struct sockaddr_in addr, int sockfd, int *sequenceNumber,
-              unsigned long long *totalBytesSent, int bytesSentThisTime, int *timeout,
-              int *retries, struct timeval *tv)
+void send_striped(struct sockaddr_in *addr, struct FileSource *source, unsigned long long rateLimit)
 {
-    socklen_t addrlen = sizeof(addr);
-    char ack[MAX_ACK_SIZE];
-
-    int bytesReceived = recvfrom(sockfd, ack, MAX_ACK_SIZE, 0, (struct sockaddr *)&addr, &addrlen);
-    if (bytesReceived < 0)
+    while (_transferId == 0)
     {
-        if (errno == EAGAIN || errno == EWOULDBLOCK)
+        if (getrandom(&_transferId, sizeof(_transferId), 0) < 0 && errno != EINTR)
         {
-            if (*retries < MAX_RETRIES)
-            {
-                *timeout *= 2;
-                (*retries)++;
+            perror("getrandom");
+            exit(1);
+        }
+    }
 
-                return;
-            }
-            else
-            {
-                perror("max timeout reached");
-                exit(1);
-            }
+    struct StripeSet stripes;
+    stripe_init(&stripes, source->length, _stripes, (unsigned long long)STRIPE_PIECE_PACKETS * _packetDataSize,
+                _packetDataSize);
+
+    // The first pieces are taken before any sub-flow starts, so a small file leaves the extra sub-flows idle
+    struct SubFlow flows[MAX_STRIPES];
+    for (int i = 0; i < _stripes; i++)
+    {
+        flows[i].address = *addr;
+        flows[i].rateLimit = rateLimit / _stripes;
+        flows[i].started = source_stripe(&flows[i].source, source, &stripes, i);
+    }
+
+    for (int i = 0; i < _stripes; i++)
+    {
+        if (!flows[i].started)
+        {
+            continue;
         }
-        else
+
+        int err = pthread_create(&flows[i].thread, NULL, send_sub_flow, &flows[i]);
+        if (err != 0)
         {
-            perror("recvfrom");
+            fprintf(stderr, "pthread_create: %s\n", strerror(err));
             exit(1);
         }
     }
 
-    uint32_t receivedSequenceNumber;
-    memcpy(&receivedSequenceNumber, ack, MAX_ACK_SIZE);
+    for (int i = 0; i < _stripes; i++)
+    {
+        if (flows[i].started)
+        {
+            pthread_join(flows[i].thread, NULL);
+        }
+    }
 
-    if (receivedSequenceNumber != *sequenceNumber)
+    if (_verbose)
     {
-        *timeout *= 2;
-        (*retries)++;
-        return;
+        fprintf(stderr, "sent the file over %d sub-flows as transfer %08x, with %u steals\n", _stripes, _transferId,
+                stripes.steals);
     }
 
-    *totalBytesSent += (bytesSentThisTime - HEADER_SIZE);
-    (*sequenceNumber)++;
-    *retries = 0;
-    *timeout = DEFAULT_TIMEOUT;
-    tv->tv_usec = *timeout;
+    stripe_destroy(&stripes);
 }
 
 /** @brief Sends the first bytesToTransfer bytes of the file indicated by
@@ -226,10 +2151,32 @@ void checkAck(struct sockaddr_in addr, int sockfd, int *sequenceNumber,
  *  The bytes are transferred correctly and efficiently, even if the network drops,
  *  duplicates, or reorders packets. See rrecv for the counterpart function.
  *
+ *  Packets are sent using a sliding window: up to _windowSize packets may be in
+ *  flight at once. Each packet is acknowledged individually and retransmitted on
+ *  its own timeout, and the window slides forward as the oldest packets are
+ *  acknowledged. SACK blocks in the ACKs let the sender retransmit a lost packet
+ *  as soon as later packets are acknowledged, without waiting for the timeout.
+ *
+ *  The number of packets in flight is also limited by the congestion window,
+ *  which is managed by the congestion control algorithm. Lost packets are
+ *  retransmitted before any new packet is sent. If a pacing rate is in effect,
+ *  packets are spread evenly at that rate instead of being sent back to back.
+ *  Packets sent together are handed to the kernel in batches with sendmmsg,
+ *  and consecutive packets are merged into UDP GSO super-buffers.
+ *
+ *  With a rate limit, a token bucket holds every packet sent, retransmissions
+ *  included, to that rate on top of the congestion window. SIGUSR1 reads a
+ *  new limit from the rate limit file, if one was given.
+ *
+ *  With more than one stripe, a mapped file is sent over that many sub-flows
+ *  at once by send_striped, to a receiver daemon that puts it back together.
+ *  An empty transfer is always sent as one flow.
+ *
  *  @param hostname The name of the receiver host.
  *  @param hostUDPport The port number on the receiver host.
  *  @param filename The name of the file to transfer.
  *  @param bytesToTransfer The number of bytes to transfer.
+ *  @param rateLimit The most bytes to send per second, or 0 for no limit.
  *  @return Void.
  *
  *  Sources:
@@ -241,15 +2188,10 @@ void checkAck(struct sockaddr_in addr, int sockfd, int *sequenceNumber,
 void rsend(char *hostname,
            unsigned short int hostUDPport,
            char *filename,
-           unsigned long long int bytesToTransfer)
+           unsigned long long int bytesToTransfer,
+           unsigned long long int rateLimit)
 {
-    // Initialize socket
-    int sockfd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-    if (sockfd < 0)
-    {
-        perror("socket");
-        exit(1);
-    }
+    watch_rate_limit();
 
     struct hostent *host = gethostbyname(hostname);
     if (host == NULL)
@@ -264,85 +2206,67 @@ void rsend(char *hostname,
     memcpy(&addr.sin_addr.s_addr, host->h_addr, host->h_length);
 
     // Prepare file for reading
-    FILE *file = fopen(filename, "rb");
-    if (file == NULL)
+    struct FileSource source;
+    unsigned poolEntries = 1;
+    while (poolEntries < (unsigned)_windowSize + READ_AHEAD_CHUNKS)
     {
-        perror("fopen");
-        exit(1);
+        poolEntries <<= 1;
     }
+    source_open(&source, filename, bytesToTransfer, _mapFile, _packetDataSize, poolEntries);
 
-    if (getFileSize(filename) < bytesToTransfer)
+    // An empty transfer has no pieces to share out, but still needs its handshake and last packet
+    if (source.length == 0)
     {
-        bytesToTransfer = getFileSize(filename);
+        _stripes = 1;
     }
 
-    // Establish connection with receiver prior to sending packets
-    establish_connection(sockfd, &addr, sizeof(addr));
-
-    unsigned long long totalBytesSent = 0;
-    char packet_data[MAX_BUFFER_SIZE];
-    char packet[MAX_BUFFER_SIZE + HEADER_SIZE];
-    struct Header header;
-
-    struct timeval tv;
-    int timeout = DEFAULT_TIMEOUT;
-    int retries = 0;
-    tv.tv_sec = 0;
-    tv.tv_usec = timeout;
-
-    while (totalBytesSent < bytesToTransfer)
+    // Sub-flows send pieces from all over the file, so only a mapped file can be striped
+    if (_stripes > 1 && source.map == NULL)
     {
-        tv.tv_usec = timeout;
-
-        if (setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0)
-        {
-            perror("timeout");
-            exit(1);
-        }
-
-        if (retries == 0)
-        {
-            int bytesRead = fread(packet_data, 1, sizeof(packet_data), file);
-            if (bytesRead < 0)
-            {
-                perror("fread");
-                exit(1);
-            }
-
-            memcpy(packet + HEADER_SIZE, packet_data, bytesRead);
-
-            header.sequenceNumber = _sequenceNumber;
-            header.messageLength = bytesRead;
-            if (totalBytesSent + MAX_BUFFER_SIZE > bytesToTransfer)
-            {
-                header.lastPacket = TRUE;
-            }
-            else
-            {
-                header.lastPacket = FALSE;
-            }
-
-            memcpy(packet, &header, HEADER_SIZE);
-        }
-
-        int bytesSentThisTime = sendto(sockfd, packet, HEADER_SIZE + MAX_BUFFER_SIZE, 0, (struct sockaddr *)&addr, sizeof(addr));
-        if (bytesSentThisTime < 0)
-        {
-            perror("sendto");
-            exit(1);
-        }
+        fprintf(stderr, "only a regular file that can be mapped can be striped, sending it as one flow\n");
+        _stripes = 1;
+    }
 
-        checkAck(addr, sockfd, &_sequenceNumber, &totalBytesSent, bytesSentThisTime, &timeout, &retries, &tv);
+    if (_stripes > 1)
+    {
+        send_striped(&addr, &source, rateLimit);
+    }
+    else
+    {
+        int sockfd = open_socket();
+        send_file(sockfd, &addr, &source, rateLimit);
+        close(sockfd);
     }
 
-    fclose(file);
-    close(sockfd);
+    source_close(&source);
+}
+
+/** @brief Prints the command line usage and exits.
+ *
+ *  @param program The name the program was run as.
+ *  @return Does not return
+ */
+void print_usage(char *program)
+{
+    fprintf(stderr, "usage: %s [-w window_size] [-r max_retries] [-M max_timeout_ms] [-c congestion_control] [-p] [-f fixed_rate_mbps] [-R rate_limit_mbps] [-L rate_limit_file] [-G] [-B] [-Z] [-s packet_data_size] [-U] [-S stripes] [-v] receiver_hostname receiver_port filename_to_xfer bytes_to_xfer\n\n", program);
+    exit(1);
 }
 
 /** @brief UDP sender entrypoint.
  *
  *  Parses the command line arguments and calls the rsend function to send
- *  the file.
+ *  the file. The window size may be given with the -w option, and the
+ *  retransmission backoff policy with the -r (retries before giving up) and
+ *  -M (maximum retransmission timeout) options. The congestion control
+ *  algorithm is chosen with the -c option. The -p option paces window-based
+ *  algorithms, and -f paces at a fixed rate in megabits per second. The -R
+ *  option limits the rate in megabits per second, and -L names a file a new
+ *  limit is read from on SIGUSR1. The -G option turns off UDP segmentation
+ *  offload, and the -B option reads the file with buffered reads instead of
+ *  mapping it into memory. The -Z option sends packets with MSG_ZEROCOPY, and
+ *  -s lowers the data carried by each packet. The -U option sends packets and
+ *  receives ACKs through io_uring. The -S option sends the file over several
+ *  sub-flows at once. The -v option prints transfer statistics at the end.
  *
  * @return Should not return
  */
@@ -352,19 +2276,130 @@ int main(int argc, char **argv)
     unsigned long long int bytesToTransfer;
     char *hostname = NULL;
     char *filename = NULL;
+    unsigned long long int rateLimit = 0;
+
+    int opt;
+    _congestionAlgorithm = congestion_find(DEFAULT_CONGESTION_CONTROL);
+
+    while ((opt = getopt(argc, argv, "w:r:M:c:pf:R:L:GBZs:US:v")) != -1)
+    {
+        switch (opt)
+        {
+        case 'w':
+            _windowSize = atoi(optarg);
+            if (_windowSize < 1)
+            {
+                fprintf(stderr, "%s: window size must be at least 1\n", argv[0]);
+                exit(1);
+            }
+            break;
+        case 'r':
+            _maxRetries = atoi(optarg);
+            if (_maxRetries < 0)
+            {
+                fprintf(stderr, "%s: retries must not be negative\n", argv[0]);
+                exit(1);
+            }
+            break;
+        case 'M':
+            if (atoll(optarg) * 1000 < MIN_TIMEOUT)
+            {
+                fprintf(stderr, "%s: maximum timeout must be at least %d ms\n", argv[0], MIN_TIMEOUT / 1000);
+                exit(1);
+            }
+            _maxTimeout = atoll(optarg) * 1000;
+            break;
+        case 'c':
+            _congestionAlgorithm = congestion_find(optarg);
+            if (_congestionAlgorithm == NULL)
+            {
+                fprintf(stderr, "%s: unknown congestion control algorithm %s\n", argv[0], optarg);
+                exit(1);
+            }
+            break;
+        case 'p':
+            _pacing = TRUE;
+            break;
+        case 'f':
+            if (atof(optarg) <= 0)
+            {
+                fprintf(stderr, "%s: fixed rate must be positive\n", argv[0]);
+                exit(1);
+            }
+            _fixedPacingRate = atof(optarg) * 1000000 / 8;
+            break;
+        case 'R':
+            if (atof(optarg) <= 0)
+            {
+                fprintf(stderr, "%s: rate limit must be positive\n", argv[0]);
+                exit(1);
+            }
+            rateLimit = atof(optarg) * 1000000 / 8;
+            break;
+        case 'L':
+            _rateLimitFile = optarg;
+            break;
+        case 'G':
+            _gsoRequested = FALSE;
+            break;
+        case 'B':
+            _mapFile = FALSE;
+            break;
+        case 'Z':
+            _zerocopyRequested = TRUE;
+            break;
+        case 's':
+            _packetDataSize = atoi(optarg);
+            if (_packetDataSize < MIN_BUFFER_SIZE || _packetDataSize > MAX_BUFFER_SIZE)
+            {
+                fprintf(stderr, "%s: packet data size must be between %d and %d bytes\n", argv[0], MIN_BUFFER_SIZE, MAX_BUFFER_SIZE);
+                exit(1);
+            }
+            break;
+        case 'U':
+            _uringRequested = TRUE;
+            break;
+        case 'S':
+            _stripes = atoi(optarg);
+            if (_stripes < 1 || _stripes > MAX_STRIPES)
+            {
+                fprintf(stderr, "%s: stripes must be between 1 and %d\n", argv[0], MAX_STRIPES);
+                exit(1);
+            }
+            break;
+        case 'v':
+            _verbose = TRUE;
+            break;
+        default:
+            print_usage(argv[0]);
+        }
+    }
+
+    if (argc - optind != 4)
+    {
+        print_usage(argv[0]);
+    }
+
+    // Completions of MSG_ZEROCOPY sends are only tracked for sends made with system calls
+    if (_zerocopyRequested && _uringRequested)
+    {
+        fprintf(stderr, "%s: -Z cannot be combined with -U\n", argv[0]);
+        exit(1);
+    }
 
-    if (argc != 5)
+    // Every sub-flow has a token bucket of its own, which a new limit would have to be split among
+    if (_stripes > 1 && _rateLimitFile != NULL)
     {
-        fprintf(stderr, "usage: %s receiver_hostname receiver_port filename_to_xfer bytes_to_xfer\n\n", argv[0]);
+        fprintf(stderr, "%s: -L cannot be combined with -S\n", argv[0]);
         exit(1);
     }
 
-    hostname = argv[1];
-    hostUDPport = (unsigned short int)atoi(argv[2]);
-    filename = argv[3];
-    bytesToTransfer = atoll(argv[4]);
+    hostname = argv[optind];
+    hostUDPport = (unsigned short int)atoi(argv[optind + 1]);
+    filename = argv[optind + 2];
+    bytesToTransfer = atoll(argv[optind + 3]);
 
-    rsend(hostname, hostUDPport, filename, bytesToTransfer);
+    rsend(hostname, hostUDPport, filename, bytesToTransfer, rateLimit);
 
     return (EXIT_SUCCESS);
 }
\ No newline at end of file
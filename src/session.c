@@ -0,0 +1,116 @@
+/** @file session.c
+ *  @brief The session table of the UDP receiver daemon
+ *
+ *  This contains the table the receiver daemon finds each session in by
+ *  the connection ID of every packet. Connection IDs are random, but are
+ *  mixed before use so that a sender picking them badly does not crowd
+ *  one part of the table. A removed session's entry is refilled from the
+ *  entries after it, so no lookup ever has to skip over a removed one.
+ *
+ *  @author Vicky Chen (chen-vv)
+ *  @author Eric Omielan (eomielan)
+ *  @bug No known bugs.
+ */
+
+/* -- Includes -- */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "include/session.h"
+
+/**
+ * @brief Returns the entry a connection ID is looked up from first.
+ *
+ * The ID is multiplied by a constant near 2^32 divided by the golden ratio,
+ * and the entry is taken from the top bits of the product, which depend on
+ * every bit of the ID.
+ *
+ * @param table The session table
+ * @param connectionId The connection ID
+ * @return The index of the entry
+ */
+unsigned session_home(struct SessionTable *table, uint32_t connectionId)
+{
+    return (uint32_t)(connectionId * 2654435761u) >> table->shift;
+}
+
+void session_table_init(struct SessionTable *table, unsigned maxSessions)
+{
+    table->size = 1;
+    table->shift = 32;
+    while (table->size < 2 * maxSessions)
+    {
+        table->size <<= 1;
+        table->shift--;
+    }
+    table->count = 0;
+
+    table->entries = calloc(table->size, sizeof(struct Session *));
+    if (table->entries == NULL)
+    {
+        perror("calloc");
+        exit(1);
+    }
+}
+
+struct Session *session_find(struct SessionTable *table, uint32_t connectionId)
+{
+    for (unsigned i = session_home(table, connectionId);; i = (i + 1) & (table->size - 1))
+    {
+        struct Session *session = table->entries[i];
+        if (session == NULL || session->connectionId == connectionId)
+        {
+            return session;
+        }
+    }
+}
+
+int session_insert(struct SessionTable *table, struct Session *session)
+{
+    if (2 * (table->count + 1) > table->size)
+    {
+        return -1;
+    }
+
+    unsigned i = session_home(table, session->connectionId);
+    while (table->entries[i] != NULL)
+    {
+        i = (i + 1) & (table->size - 1);
+    }
+
+    table->entries[i] = session;
+    table->count++;
+
+    return 0;
+}
+
+void session_remove(struct SessionTable *table, struct Session *session)
+{
+    unsigned mask = table->size - 1;
+    unsigned hole = session_home(table, session->connectionId);
+    while (table->entries[hole] != session)
+    {
+        hole = (hole + 1) & mask;
+    }
+
+    // Move back every later session of the run that would no longer be found past the hole
+    for (unsigned i = (hole + 1) & mask; table->entries[i] != NULL; i = (i + 1) & mask)
+    {
+        unsigned home = session_home(table, table->entries[i]->connectionId);
+        if (((i - home) & mask) >= ((i - hole) & mask))
+        {
+            table->entries[hole] = table->entries[i];
+            hole = i;
+        }
+    }
+
+    table->entries[hole] = NULL;
+    table->count--;
+}
+
+void session_table_destroy(struct SessionTable *table)
+{
+    free(table->entries);
+    table->entries = NULL;
+}
@@ -0,0 +1,245 @@
+/** @file source.c
+ *  @brief Reading the file sent by the UDP sender
+ *
+ *  This contains the file source used by the sender. Regular files are
+ *  mapped read-only and advised as read sequentially, so the kernel reads
+ *  ahead aggressively and the sender hands pointers into the page cache
+ *  straight to the socket. Anything that cannot be mapped is read with
+ *  stdio by a reader thread, which fills chunks of a fixed pool ahead of
+ *  the sender. The sender keeps each chunk as the packet's data until the
+ *  packet's window entry is reused, so retransmissions need no reads.
+ *
+ *  @author Vicky Chen (chen-vv)
+ *  @author Eric Omielan (eomielan)
+ *  @bug A mapped file must not be truncated while it is being sent.
+ */
+
+/* -- Includes -- */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "include/source.h"
+#include "include/stripe.h"
+
+/**
+ * @brief The reader thread, which reads the file into the pool until the end of the data to send.
+ *
+ * @param arg The file source
+ * @return NULL
+ */
+void *source_run(void *arg)
+{
+    struct FileSource *source = arg;
+    unsigned long long remaining = source->length;
+
+    while (1)
+    {
+        struct ReadChunk *chunk = ring_reserve(&source->pool);
+
+        size_t length = remaining < source->chunkSize ? remaining : source->chunkSize;
+        size_t bytesRead = fread(chunk->data, 1, length, source->file);
+        if (bytesRead < length && ferror(source->file))
+        {
+            perror("fread");
+            exit(1);
+        }
+
+        // The file may end before the bytes asked for have been sent
+        remaining -= bytesRead;
+        chunk->length = bytesRead;
+        chunk->last = bytesRead < length || remaining == 0;
+
+        if (chunk->last)
+        {
+            ring_close(&source->pool);
+            return NULL;
+        }
+
+        ring_commit(&source->pool);
+    }
+}
+
+/**
+ * @brief Sets up the pool and starts the reader thread.
+ *
+ * @param source The file source
+ * @param poolEntries The number of chunks in the pool, a power of two
+ * @return Void
+ */
+void start_reader(struct FileSource *source, unsigned poolEntries)
+{
+    // Keep each chunk aligned, as the chunks sit one after another
+    size_t slotSize = (sizeof(struct ReadChunk) + source->chunkSize + 7) & ~(size_t)7;
+    ring_init(&source->pool, poolEntries, slotSize);
+
+    int err = pthread_create(&source->reader, NULL, source_run, source);
+    if (err != 0)
+    {
+        fprintf(stderr, "pthread_create: %s\n", strerror(err));
+        exit(1);
+    }
+}
+
+void source_open(struct FileSource *source, const char *filename, unsigned long long bytesToTransfer, int useMap,
+                 size_t chunkSize, unsigned poolEntries)
+{
+    memset(source, 0, sizeof(*source));
+
+    source->file = fopen(filename, "rb");
+    if (source->file == NULL)
+    {
+        perror("fopen");
+        exit(1);
+    }
+
+    source->length = bytesToTransfer;
+    source->chunkSize = chunkSize;
+
+    struct stat st;
+    if (fstat(fileno(source->file), &st) < 0)
+    {
+        perror("fstat");
+        exit(1);
+    }
+
+    // Only a regular file has a known size, and only a regular file can be mapped
+    if (!S_ISREG(st.st_mode))
+    {
+        start_reader(source, poolEntries);
+        return;
+    }
+
+    if ((unsigned long long)st.st_size < source->length)
+    {
+        source->length = st.st_size;
+    }
+    source->knownLength = 1;
+
+    // An empty mapping is not allowed, and there is nothing to gain from one
+    if (!useMap || source->length == 0)
+    {
+        start_reader(source, poolEntries);
+        return;
+    }
+
+    void *map = mmap(NULL, source->length, PROT_READ, MAP_SHARED, fileno(source->file), 0);
+    if (map == MAP_FAILED)
+    {
+        start_reader(source, poolEntries);
+        return;
+    }
+
+    // The file is read front to back, so the kernel may read far ahead and drop pages behind
+    madvise(map, source->length, MADV_SEQUENTIAL);
+    source->map = map;
+}
+
+int source_stripe(struct FileSource *view, const struct FileSource *source, struct StripeSet *stripes, unsigned index)
+{
+    memset(view, 0, sizeof(*view));
+    view->map = source->map;
+    view->length = source->length;
+    view->knownLength = source->knownLength;
+    view->chunkSize = source->chunkSize;
+    view->stripes = stripes;
+    view->stripe = index;
+
+    return stripe_next(stripes, index, &view->pieceNext, &view->pieceEnd);
+}
+
+/**
+ * @brief Gets the next chunk of the piece a sub-flow is sending.
+ *
+ * The next piece is taken as soon as one is used up, so the chunk that ends
+ * the sub-flow's share of the file is known to be its last.
+ *
+ * @param source The sub-flow's view of the file
+ * @param data Set to the chunk
+ * @return The number of bytes in the chunk
+ */
+size_t source_read_stripe(struct FileSource *source, const char **data)
+{
+    size_t length = source->chunkSize;
+    if (length > source->pieceEnd - source->pieceNext)
+    {
+        length = source->pieceEnd - source->pieceNext;
+    }
+
+    *data = source->map + source->pieceNext;
+    source->position = source->pieceNext;
+    source->pieceNext += length;
+    source->offset += length;
+
+    if (source->pieceNext == source->pieceEnd)
+    {
+        source->done = !stripe_next(source->stripes, source->stripe, &source->pieceNext, &source->pieceEnd);
+    }
+
+    return length;
+}
+
+size_t source_read(struct FileSource *source, const char **data)
+{
+    if (source->stripes != NULL)
+    {
+        return source_read_stripe(source, data);
+    }
+
+    source->position = source->offset;
+
+    if (source->map != NULL)
+    {
+        size_t length = source->chunkSize;
+        if (length > source->length - source->offset)
+        {
+            length = source->length - source->offset;
+        }
+
+        *data = source->map + source->offset;
+        source->offset += length;
+        source->done = source->offset == source->length;
+        return length;
+    }
+
+    ring_wait(&source->pool, source->readPosition);
+    struct ReadChunk *chunk = ring_slot(&source->pool, source->readPosition++);
+
+    // The file ended early, so there is nothing more to send
+    if (chunk->last)
+    {
+        source->length = source->offset + chunk->length;
+    }
+
+    *data = chunk->data;
+    source->offset += chunk->length;
+    source->done = source->offset == source->length;
+    return chunk->length;
+}
+
+void source_release(struct FileSource *source)
+{
+    if (source->map == NULL)
+    {
+        ring_release(&source->pool, source->pool.head + 1);
+    }
+}
+
+void source_close(struct FileSource *source)
+{
+    if (source->map != NULL)
+    {
+        munmap((void *)source->map, source->length);
+    }
+    else
+    {
+        pthread_join(source->reader, NULL);
+        ring_destroy(&source->pool);
+    }
+
+    fclose(source->file);
+}
@@ -0,0 +1,106 @@
+/** @file stripe.c
+ *  @brief Sharing a file out among the sub-flows of a striped transfer
+ *
+ *  This contains the work stealing scheduler of striped transfers. Each
+ *  sub-flow starts with an equal range of the file and takes a piece of
+ *  it at a time. When its range runs dry, it takes over the back half of
+ *  the largest range left, which its owner has not started on yet, so
+ *  every sub-flow keeps sending until the whole file has been taken.
+ *
+ *  @author Vicky Chen (chen-vv)
+ *  @author Eric Omielan (eomielan)
+ *  @bug No known bugs.
+ */
+
+/* -- Includes -- */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "include/stripe.h"
+#include "include/udp.h"
+
+void stripe_init(struct StripeSet *set, unsigned long long length, unsigned count, unsigned long long pieceSize,
+                 unsigned long long granule)
+{
+    pthread_mutex_init(&set->lock, NULL);
+    set->count = count;
+    set->pieceSize = pieceSize;
+    set->granule = granule;
+    set->steals = 0;
+
+    set->ranges = calloc(count, sizeof(struct StripeRange));
+    if (set->ranges == NULL)
+    {
+        perror("calloc");
+        exit(1);
+    }
+
+    // Every range but the last is a whole number of packets, so only the last packet of the file is short
+    unsigned long long granules = (length + granule - 1) / granule;
+    unsigned long long start = 0;
+    for (unsigned i = 0; i < count; i++)
+    {
+        unsigned long long end = (granules * (i + 1) / count) * granule;
+        if (end > length)
+        {
+            end = length;
+        }
+
+        set->ranges[i].next = start;
+        set->ranges[i].end = end;
+        start = end;
+    }
+}
+
+int stripe_next(struct StripeSet *set, unsigned index, unsigned long long *start, unsigned long long *end)
+{
+    pthread_mutex_lock(&set->lock);
+
+    struct StripeRange *range = &set->ranges[index];
+    if (range->next == range->end)
+    {
+        struct StripeRange *victim = NULL;
+        for (unsigned i = 0; i < set->count; i++)
+        {
+            struct StripeRange *other = &set->ranges[i];
+            if (other->end - other->next > 0 && (victim == NULL || other->end - other->next > victim->end - victim->next))
+            {
+                victim = other;
+            }
+        }
+
+        if (victim == NULL)
+        {
+            pthread_mutex_unlock(&set->lock);
+            return FALSE;
+        }
+
+        // The owner goes on with the front half, and a range too small to halve is taken whole
+        unsigned long long keep = ((victim->end - victim->next) / 2 + set->granule - 1) / set->granule * set->granule;
+        unsigned long long split = victim->next + keep;
+        if (split >= victim->end)
+        {
+            split = victim->next;
+        }
+
+        range->next = split;
+        range->end = victim->end;
+        victim->end = split;
+        set->steals++;
+    }
+
+    *start = range->next;
+    *end = range->end - range->next > set->pieceSize ? range->next + set->pieceSize : range->end;
+    range->next = *end;
+
+    pthread_mutex_unlock(&set->lock);
+    return TRUE;
+}
+
+void stripe_destroy(struct StripeSet *set)
+{
+    pthread_mutex_destroy(&set->lock);
+    free(set->ranges);
+    set->ranges = NULL;
+}
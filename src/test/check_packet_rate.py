@@ -0,0 +1,50 @@
+import math
+import os
+import subprocess
+import sys
+import time
+
+RECEIVE_FILENAME = "received.bin"
+SEND_FILENAME = "packet_rate.bin"
+PACKET_DATA_SIZE = 8192
+
+
+def measure_packet_rate(size, sender_options):
+    receiver_process = subprocess.Popen(["../../receiver", "12345", RECEIVE_FILENAME])
+
+    time.sleep(1)
+
+    start = time.time()
+
+    sender_process = subprocess.Popen(
+        ["../../sender", *sender_options, "localhost", "12345", SEND_FILENAME, str(size)]
+    )
+
+    # wait4 reports the CPU time each process used, so the rate can be given per core
+    _, _, receiver_usage = os.wait4(receiver_process.pid, 0)
+    _, _, sender_usage = os.wait4(sender_process.pid, 0)
+
+    end = time.time()
+
+    packets = math.ceil(size / PACKET_DATA_SIZE)
+    duration = end - start
+    receiver_cpu = receiver_usage.ru_utime + receiver_usage.ru_stime
+    sender_cpu = sender_usage.ru_utime + sender_usage.ru_stime
+
+    return packets, duration, receiver_cpu, sender_cpu
+
+
+size = int(sys.argv[1]) if len(sys.argv) > 1 else 200 * 1024 * 1024
+sender_options = sys.argv[2:]
+
+with open(SEND_FILENAME, "wb") as send_file:
+    send_file.write(os.urandom(size))
+
+try:
+    packets, duration, receiver_cpu, sender_cpu = measure_packet_rate(size, sender_options)
+finally:
+    os.remove(SEND_FILENAME)
+
+print("Transferred {} packets in {:.3f} seconds: {:.0f} packets/sec".format(packets, duration, packets / duration))
+print("Receiver: {:.3f} CPU seconds, {:.0f} packets/sec/core".format(receiver_cpu, packets / receiver_cpu))
+print("Sender: {:.3f} CPU seconds, {:.0f} packets/sec/core".format(sender_cpu, packets / sender_cpu))
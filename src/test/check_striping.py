@@ -0,0 +1,66 @@
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+SEND_FILENAME = "striping.bin"
+STRIPE_COUNTS = [1, 2, 4, 8]
+
+
+def measure_transfer(size, stripes, sender_options):
+    with tempfile.TemporaryDirectory() as directory:
+        # A worker per sub-flow, so the sub-flows are not held back by one receiving thread
+        receiver_process = subprocess.Popen(["../../receiver", "-D", "-T", str(stripes), "12345", directory])
+
+        time.sleep(1)
+
+        start = time.time()
+
+        sender_process = subprocess.Popen(
+            ["../../sender", *sender_options, "-S", str(stripes), "localhost", "12345", SEND_FILENAME, str(size)]
+        )
+        sender_process.wait()
+
+        # The sub-flows all write into the one file of the transfer, which may still be being written
+        complete = False
+        deadline = time.time() + 10
+        while not complete and time.time() < deadline:
+            names = os.listdir(directory)
+            complete = len(names) == 1 and os.path.getsize(os.path.join(directory, names[0])) == size
+            if not complete:
+                time.sleep(0.001)
+
+        end = time.time()
+
+        receiver_process.terminate()
+        receiver_process.wait()
+
+    return end - start, complete
+
+
+size = int(sys.argv[1]) if len(sys.argv) > 1 else 100 * 1024 * 1024
+sender_options = sys.argv[2:]
+
+with open(SEND_FILENAME, "wb") as send_file:
+    send_file.write(os.urandom(size))
+
+try:
+    print("{:>8} {:>12} {:>10} {:>8}".format("stripes", "seconds", "Mbps", "speedup"))
+    single_duration = None
+    for stripes in STRIPE_COUNTS:
+        duration, complete = measure_transfer(size, stripes, sender_options)
+        if single_duration is None:
+            single_duration = duration
+
+        print(
+            "{:>8} {:>12.3f} {:>10.2f} {:>8.2f}{}".format(
+                stripes,
+                duration,
+                size * 8 / duration / (1024 * 1024),
+                single_duration / duration,
+                "" if complete else "  (incomplete)",
+            )
+        )
+finally:
+    os.remove(SEND_FILENAME)
@@ -0,0 +1,62 @@
+import os
+import subprocess
+import sys
+import time
+
+RECEIVE_FILENAME = "received.bin"
+SEND_FILENAME = "zerocopy.bin"
+PACKET_DATA_SIZES = [256, 512, 1024, 2048, 4096, 8192]
+
+
+def measure_sender_cpu(size, sender_options):
+    receiver_process = subprocess.Popen(["../../receiver", "12345", RECEIVE_FILENAME])
+
+    time.sleep(1)
+
+    sender_process = subprocess.Popen(
+        ["../../sender", *sender_options, "localhost", "12345", SEND_FILENAME, str(size)]
+    )
+
+    # wait4 reports the CPU time each process used, so the sender's cost can be told apart
+    _, _, sender_usage = os.wait4(sender_process.pid, 0)
+    os.wait4(receiver_process.pid, 0)
+
+    return sender_usage.ru_utime + sender_usage.ru_stime
+
+
+size = int(sys.argv[1]) if len(sys.argv) > 1 else 100 * 1024 * 1024
+sender_options = sys.argv[2:]
+
+with open(SEND_FILENAME, "wb") as send_file:
+    send_file.write(os.urandom(size))
+
+results = []
+
+try:
+    print("{:>10} {:>14} {:>16} {:>8}".format("data size", "copy (us/MB)", "zerocopy (us/MB)", "ratio"))
+    for data_size in PACKET_DATA_SIZES:
+        options = [*sender_options, "-s", str(data_size)]
+        copy_cpu = measure_sender_cpu(size, options)
+        zerocopy_cpu = measure_sender_cpu(size, [*options, "-Z"])
+
+        megabytes = size / 1000000
+        print(
+            "{:>10} {:>14.0f} {:>16.0f} {:>8.2f}".format(
+                data_size, copy_cpu * 1000000 / megabytes, zerocopy_cpu * 1000000 / megabytes, zerocopy_cpu / copy_cpu
+            )
+        )
+        results.append((data_size, zerocopy_cpu < copy_cpu))
+finally:
+    os.remove(SEND_FILENAME)
+
+# Zero-copy pays off from the smallest size at which it wins at every larger size as well
+break_even = None
+for data_size, zerocopy_wins in reversed(results):
+    if not zerocopy_wins:
+        break
+    break_even = data_size
+
+if break_even is None:
+    print("Zero-copy did not lower the sender's CPU time at the largest packet sizes tried")
+else:
+    print("Zero-copy lowers the sender's CPU time from {} bytes of data per packet".format(break_even))
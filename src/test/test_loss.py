@@ -0,0 +1,171 @@
+import os
+import random
+import select
+import socket
+import subprocess
+import threading
+
+import pytest
+
+RECEIVER_PORT = 12345
+PROXY_PORT = 12347
+HOSTNAME = "localhost"
+BUFFER_SIZE = 4 * 1024 * 1024  # Room for a full window, so the proxy itself does not drop packets
+
+
+class LossyProxy(threading.Thread):
+    """Relays datagrams between the sender and the receiver, dropping and reordering some of them."""
+
+    def __init__(self, drop_rate, reorder_rate, seed=1):
+        super().__init__(daemon=True)
+        self.drop_rate = drop_rate
+        self.reorder_rate = reorder_rate
+        self.random = random.Random(seed)
+        self.stopped = threading.Event()
+
+        # Packets from the sender arrive here
+        self.downstream = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.downstream.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, BUFFER_SIZE)
+        self.downstream.bind((HOSTNAME, PROXY_PORT))
+
+        # Packets are forwarded to the receiver from here, so the receiver replies here
+        self.upstream = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.upstream.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, BUFFER_SIZE)
+        self.receiver_addr = (HOSTNAME, RECEIVER_PORT)
+
+        self.sender_addr = None
+        self.held = {self.downstream: None, self.upstream: None}
+        self.sender_datagrams = []
+
+    def forward(self, source, data):
+        if self.random.random() < self.drop_rate:
+            return
+
+        if source is self.downstream:
+            send = lambda packet: self.upstream.sendto(packet, self.receiver_addr)
+        else:
+            send = lambda packet: self.downstream.sendto(packet, self.sender_addr)
+
+        # Hold a packet back and release it after the next one to reorder them
+        if self.held[source] is None and self.random.random() < self.reorder_rate:
+            self.held[source] = data
+            return
+
+        send(data)
+        if self.held[source] is not None:
+            send(self.held[source])
+            self.held[source] = None
+
+    def run(self):
+        while not self.stopped.is_set():
+            readable, _, _ = select.select([self.downstream, self.upstream], [], [], 0.1)
+            for sock in readable:
+                data, addr = sock.recvfrom(65536)
+                if sock is self.downstream:
+                    self.sender_addr = addr
+                    self.sender_datagrams.append(data)
+                if self.sender_addr is not None:
+                    self.forward(sock, data)
+
+    def stop(self):
+        self.stopped.set()
+        self.join()
+        self.downstream.close()
+        self.upstream.close()
+
+
+@pytest.mark.parametrize(
+    "send_filename, receive_filename, drop_rate, reorder_rate, congestion_control, receiver_options",
+    [
+        ("hotpot.jpg", "received.jpg", 0.0, 0.1, "newreno", []),
+        ("hotpot.jpg", "received.jpg", 0.02, 0.0, "newreno", []),
+        ("quacks.mp3", "received.mp3", 0.02, 0.05, "newreno", []),
+        ("quacks.mp3", "received.mp3", 0.02, 0.05, "cubic", []),
+        ("quacks.mp3", "received.mp3", 0.02, 0.05, "bbr", []),
+        ("quacks.mp3", "received.mp3", 0.02, 0.05, "newreno", ["-U"]),
+    ],
+)
+def test_lossy_transfer(send_filename, receive_filename, drop_rate, reorder_rate, congestion_control, receiver_options):
+    # Clear received file before each test
+    with open(receive_filename, "wb"):
+        pass
+
+    with open(send_filename, "rb") as send_file:
+        send_data = send_file.read()
+
+    proxy = LossyProxy(drop_rate, reorder_rate)
+    proxy.start()
+
+    receiver_process = subprocess.Popen(["../../receiver", *receiver_options, str(RECEIVER_PORT), receive_filename])
+
+    sender_process = subprocess.Popen(
+        [
+            "../../sender",
+            "-c",
+            congestion_control,
+            HOSTNAME,
+            str(PROXY_PORT),
+            send_filename,
+            str(os.path.getsize(send_filename)),
+        ]
+    )
+
+    try:
+        assert sender_process.wait(timeout=60) == 0
+        receiver_process.wait(timeout=10)
+    finally:
+        sender_process.kill()
+        receiver_process.kill()
+        proxy.stop()
+
+    with open(receive_filename, "rb") as received_file:
+        received_data = received_file.read()
+
+    assert len(send_data) == len(received_data)
+    assert send_data == received_data
+
+
+def test_datagrams_sized_to_payload():
+    send_filename = "sample.txt"
+    receive_filename = "received.txt"
+
+    with open(send_filename, "rb") as send_file:
+        send_data = send_file.read()
+
+    proxy = LossyProxy(0.0, 0.0)
+    proxy.start()
+
+    receiver_process = subprocess.Popen(["../../receiver", str(RECEIVER_PORT), receive_filename])
+    sender_process = subprocess.Popen(
+        ["../../sender", HOSTNAME, str(PROXY_PORT), send_filename, str(len(send_data))]
+    )
+
+    try:
+        assert sender_process.wait(timeout=30) == 0
+        receiver_process.wait(timeout=10)
+    finally:
+        sender_process.kill()
+        receiver_process.kill()
+        proxy.stop()
+
+    # The data packet carries a version 1 header of 8 bytes and the 6-byte connection ID
+    # extension, followed by just the file's bytes
+    data_packets = [
+        data
+        for data in proxy.sender_datagrams
+        if len(data) >= 14
+        and data[0] >> 4 == 1
+        and data[1] == 14
+        and data[8:10] == bytes([1, 4])
+        and int.from_bytes(data[2:4], "big") == len(data) - 14
+    ]
+    assert len(data_packets) >= 1
+    assert all(len(data) == 14 + len(send_data) for data in data_packets)
+    assert data_packets[0][14:] == send_data
+
+    with open(receive_filename, "rb") as received_file:
+        assert received_file.read() == send_data
+
+
+if __name__ == "__main__":
+    pytest.main(["-v"])
@@ -1,18 +1,26 @@
 import os
+import signal
 import subprocess
+import tempfile
+import time
 
 import pytest
 
 
 @pytest.mark.parametrize(
-    "send_filename, receive_filename",
+    "send_filename, receive_filename, sender_options",
     [
-        ("sample.txt", "received.txt"),
-        ("hotpot.jpg", "received.jpg"),
-        ("quacks.mp3", "received.mp3"),
+        ("sample.txt", "received.txt", []),
+        ("hotpot.jpg", "received.jpg", []),
+        ("quacks.mp3", "received.mp3", []),
+        ("hotpot.jpg", "received.jpg", ["-G"]),
+        ("quacks.mp3", "received.mp3", ["-B"]),
+        ("quacks.mp3", "received.mp3", ["-Z"]),
+        ("hotpot.jpg", "received.jpg", ["-Z", "-B", "-s", "1000"]),
+        ("quacks.mp3", "received.mp3", ["-U"]),
     ],
 )
-def test_file_transfer(send_filename, receive_filename):
+def test_file_transfer(send_filename, receive_filename, sender_options):
     # Clear received file before each test
     with open(receive_filename, "wb"):
         pass
@@ -26,7 +34,7 @@ def test_file_transfer(send_filename, receive_filename):
     receiver_process = subprocess.Popen(["../../receiver", "12345", receive_filename])
 
     sender_process = subprocess.Popen(
-        ["../../sender", "localhost", "12345", send_filename, str(os.path.getsize(send_filename))]
+        ["../../sender", *sender_options, "localhost", "12345", send_filename, str(os.path.getsize(send_filename))]
     )
 
     sender_process.wait()
@@ -39,5 +47,297 @@ def test_file_transfer(send_filename, receive_filename):
     assert send_data == received_data
 
 
+def test_fixed_rate_transfer():
+    send_filename = "hotpot.jpg"
+    receive_filename = "received.jpg"
+    rate_mbps = 40
+
+    with open(receive_filename, "wb"):
+        pass
+
+    with open(send_filename, "rb") as send_file:
+        send_data = send_file.read()
+
+    receiver_process = subprocess.Popen(["../../receiver", "12345", receive_filename])
+
+    start = time.monotonic()
+    sender_process = subprocess.Popen(
+        ["../../sender", "-f", str(rate_mbps), "localhost", "12345", send_filename, str(len(send_data))]
+    )
+
+    assert sender_process.wait(timeout=30) == 0
+    elapsed = time.monotonic() - start
+    receiver_process.wait(timeout=10)
+
+    # The pacer must hold the sender close to the fixed rate
+    expected = len(send_data) * 8 / (rate_mbps * 1000000)
+    assert elapsed >= 0.8 * expected
+
+    with open(receive_filename, "rb") as received_file:
+        received_data = received_file.read()
+
+    assert send_data == received_data
+
+
+def test_write_rate_transfer():
+    send_filename = "quacks.mp3"
+    receive_filename = "received.mp3"
+    write_rate = 1000000
+
+    with open(receive_filename, "wb"):
+        pass
+
+    with open(send_filename, "rb") as send_file:
+        send_data = send_file.read()
+
+    receiver_process = subprocess.Popen(["../../receiver", "12345", receive_filename, str(write_rate)])
+
+    start = time.monotonic()
+    sender_process = subprocess.Popen(["../../sender", "localhost", "12345", send_filename, str(len(send_data))])
+
+    # The receive window must slow the sender down to the write rate without it giving up
+    assert sender_process.wait(timeout=30) == 0
+    elapsed = time.monotonic() - start
+    receiver_process.wait(timeout=10)
+
+    expected = len(send_data) / write_rate
+    assert elapsed >= 0.8 * expected
+
+    with open(receive_filename, "rb") as received_file:
+        received_data = received_file.read()
+
+    assert send_data == received_data
+
+
+def test_rate_limited_transfer():
+    send_filename = "hotpot.jpg"
+    receive_filename = "received.jpg"
+    rate_mbps = 40
+
+    with open(receive_filename, "wb"):
+        pass
+
+    with open(send_filename, "rb") as send_file:
+        send_data = send_file.read()
+
+    receiver_process = subprocess.Popen(["../../receiver", "12345", receive_filename])
+
+    start = time.monotonic()
+    sender_process = subprocess.Popen(
+        ["../../sender", "-R", str(rate_mbps), "localhost", "12345", send_filename, str(len(send_data))]
+    )
+
+    assert sender_process.wait(timeout=30) == 0
+    elapsed = time.monotonic() - start
+    receiver_process.wait(timeout=10)
+
+    # The token bucket must hold the sender to the rate limit
+    expected = len(send_data) * 8 / (rate_mbps * 1000000)
+    assert elapsed >= 0.8 * expected
+
+    with open(receive_filename, "rb") as received_file:
+        received_data = received_file.read()
+
+    assert send_data == received_data
+
+
+def test_rate_limit_change():
+    send_filename = "hotpot.jpg"
+    receive_filename = "received.jpg"
+
+    with open(receive_filename, "wb"):
+        pass
+
+    with open(send_filename, "rb") as send_file:
+        send_data = send_file.read()
+
+    with tempfile.NamedTemporaryFile("w", suffix=".rate") as rate_file:
+        rate_file.write("400\n")
+        rate_file.flush()
+
+        receiver_process = subprocess.Popen(["../../receiver", "12345", receive_filename])
+
+        # At 1 Mbit/s the file would take half a minute
+        sender_process = subprocess.Popen(
+            ["../../sender", "-R", "1", "-L", rate_file.name, "localhost", "12345", send_filename, str(len(send_data))]
+        )
+
+        time.sleep(0.5)
+        sender_process.send_signal(signal.SIGUSR1)
+
+        assert sender_process.wait(timeout=10) == 0
+        receiver_process.wait(timeout=10)
+
+    with open(receive_filename, "rb") as received_file:
+        received_data = received_file.read()
+
+    assert send_data == received_data
+
+
+@pytest.mark.parametrize("threads", [1, 4])
+def test_daemon_transfer(threads):
+    send_filenames = ["sample.txt", "hotpot.jpg", "quacks.mp3"]
+
+    send_data = []
+    for send_filename in send_filenames:
+        with open(send_filename, "rb") as send_file:
+            send_data.append(send_file.read())
+
+    with tempfile.TemporaryDirectory() as directory:
+        receiver_process = subprocess.Popen(
+            ["../../receiver", "-D", "-T", str(threads), "12345", directory], stderr=subprocess.PIPE, text=True
+        )
+        time.sleep(0.2)
+
+        # Every sender shares the one port, told apart by its connection ID
+        sender_processes = [
+            subprocess.Popen(["../../sender", "localhost", "12345", send_filename, str(len(data))])
+            for send_filename, data in zip(send_filenames, send_data)
+        ]
+
+        for sender_process in sender_processes:
+            assert sender_process.wait(timeout=30) == 0
+
+        # Each file is complete once its session has ended
+        received_data = []
+        deadline = time.monotonic() + 10
+        while time.monotonic() < deadline:
+            received_data = []
+            for name in os.listdir(directory):
+                with open(os.path.join(directory, name), "rb") as received_file:
+                    received_data.append(received_file.read())
+
+            if sorted(received_data) == sorted(send_data):
+                break
+            time.sleep(0.1)
+
+        receiver_process.terminate()
+        _, log = receiver_process.communicate(timeout=10)
+
+    assert sorted(received_data) == sorted(send_data)
+
+    # The kernel steers every session to the worker its connection ID picks
+    started = [line.split() for line in log.splitlines() if " started by " in line]
+    assert len(started) == len(send_filenames)
+    for fields in started:
+        assert int(fields[1].rstrip(":"), 16) % threads == int(fields[-1])
+
+
+def test_daemon_many_sessions():
+    threads = 4
+    send_filenames = ["sample.txt", "hotpot.jpg"] * 24
+
+    send_data = []
+    for send_filename in send_filenames:
+        with open(send_filename, "rb") as send_file:
+            send_data.append(send_file.read())
+
+    with tempfile.TemporaryDirectory() as directory:
+        receiver_process = subprocess.Popen(
+            ["../../receiver", "-D", "-T", str(threads), "12345", directory], stderr=subprocess.PIPE, text=True
+        )
+        time.sleep(0.2)
+
+        # Each worker holds a dozen sessions at once, so its session table has to spread them out
+        sender_processes = [
+            subprocess.Popen(["../../sender", "localhost", "12345", send_filename, str(len(data))])
+            for send_filename, data in zip(send_filenames, send_data)
+        ]
+
+        for sender_process in sender_processes:
+            assert sender_process.wait(timeout=60) == 0
+
+        received_data = []
+        deadline = time.monotonic() + 10
+        while time.monotonic() < deadline:
+            received_data = []
+            for name in os.listdir(directory):
+                with open(os.path.join(directory, name), "rb") as received_file:
+                    received_data.append(received_file.read())
+
+            if sorted(received_data) == sorted(send_data):
+                break
+            time.sleep(0.1)
+
+        receiver_process.terminate()
+        _, log = receiver_process.communicate(timeout=10)
+
+    assert sorted(received_data) == sorted(send_data)
+
+    started = [line.split() for line in log.splitlines() if " started by " in line]
+    assert len(started) == len(send_filenames)
+    for fields in started:
+        assert int(fields[1].rstrip(":"), 16) % threads == int(fields[-1])
+
+
+@pytest.mark.parametrize("send_filename", ["hotpot.jpg", "quacks.mp3"])
+def test_striped_transfer(send_filename):
+    with open(send_filename, "rb") as send_file:
+        send_data = send_file.read()
+
+    with tempfile.TemporaryDirectory() as directory:
+        receiver_process = subprocess.Popen(
+            ["../../receiver", "-D", "-T", "4", "12345", directory], stderr=subprocess.PIPE, text=True
+        )
+        time.sleep(0.2)
+
+        sender_process = subprocess.Popen(
+            ["../../sender", "-S", "4", "localhost", "12345", send_filename, str(len(send_data))]
+        )
+        assert sender_process.wait(timeout=30) == 0
+
+        # The sub-flows write their pieces into one file, named by the transfer ID
+        received_data = None
+        deadline = time.monotonic() + 10
+        while time.monotonic() < deadline:
+            names = os.listdir(directory)
+            if len(names) == 1:
+                with open(os.path.join(directory, names[0]), "rb") as received_file:
+                    received_data = received_file.read()
+
+                if received_data == send_data:
+                    break
+            time.sleep(0.1)
+
+        receiver_process.terminate()
+        _, log = receiver_process.communicate(timeout=10)
+
+    assert received_data == send_data
+
+    # Every sub-flow is a session of its own, all of the same transfer
+    started = [line.split() for line in log.splitlines() if " started by " in line]
+    assert len(started) == 4
+    assert len({fields[-4] for fields in started}) == 1
+    assert all(fields[-4] == names[0] for fields in started)
+
+
+def test_striped_empty_transfer():
+    with tempfile.TemporaryDirectory() as directory:
+        receiver_process = subprocess.Popen(
+            ["../../receiver", "-D", "-T", "4", "12345", directory], stderr=subprocess.PIPE, text=True
+        )
+        time.sleep(0.2)
+
+        # There is nothing to stripe, so the transfer goes over one flow, handshake and all
+        sender_process = subprocess.Popen(["../../sender", "-S", "4", "localhost", "12345", "sample.txt", "0"])
+        assert sender_process.wait(timeout=30) == 0
+
+        names = []
+        deadline = time.monotonic() + 10
+        while time.monotonic() < deadline:
+            names = os.listdir(directory)
+            if names:
+                break
+            time.sleep(0.1)
+
+        receiver_process.terminate()
+        _, log = receiver_process.communicate(timeout=10)
+
+        assert len(names) == 1
+        assert os.path.getsize(os.path.join(directory, names[0])) == 0
+
+    assert len([line for line in log.splitlines() if " started by " in line]) == 1
+
+
 if __name__ == "__main__":
     pytest.main(["-v"])
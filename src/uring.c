@@ -0,0 +1,332 @@
+/** @file uring.c
+ *  @brief io_uring rings for the UDP sender and receiver
+ *
+ *  This contains a minimal io_uring wrapper built on the raw
+ *  io_uring_setup and io_uring_enter system calls. The rings are mapped
+ *  into memory once. Submission queue entries are filled in place and
+ *  published by moving the tail with a release store, and completions
+ *  are read after an acquire load of the completion queue tail.
+ *
+ *  @author Vicky Chen (chen-vv)
+ *  @author Eric Omielan (eomielan)
+ *  @bug No known bugs.
+ */
+
+/* -- Includes -- */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "include/uring.h"
+
+/**
+ * @brief Calls io_uring_enter.
+ *
+ * @param ring The io_uring
+ * @param toSubmit The number of submission queue entries to hand to the kernel
+ * @param minComplete The number of completions to wait for
+ * @param flags The io_uring_enter flags
+ * @param arg The extended argument, or NULL
+ * @return The number of entries submitted, or -1 with errno set on failure
+ */
+int uring_enter(struct Uring *ring, unsigned toSubmit, unsigned minComplete, unsigned flags,
+                struct io_uring_getevents_arg *arg)
+{
+    ring->enterCalls++;
+    return syscall(__NR_io_uring_enter, ring->fd, toSubmit, minComplete, flags, arg, arg != NULL ? sizeof(*arg) : 0);
+}
+
+/**
+ * @brief Publishes the entries handed out by uring_get_sqe to the kernel.
+ *
+ * @param ring The io_uring
+ * @return The number of entries the kernel has not consumed yet
+ */
+unsigned uring_flush(struct Uring *ring)
+{
+    // The entries must be written before the kernel can see the new tail
+    __atomic_store_n(ring->sqTail, ring->sqeTail, __ATOMIC_RELEASE);
+
+    return ring->sqeTail - __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE);
+}
+
+int uring_init(struct Uring *ring, unsigned entries)
+{
+    memset(ring, 0, sizeof(*ring));
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    ring->fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (ring->fd < 0)
+    {
+        return -1;
+    }
+
+    unsigned required = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_SUBMIT_STABLE | IORING_FEAT_EXT_ARG;
+    if ((params.features & required) != required)
+    {
+        close(ring->fd);
+        errno = ENOSYS;
+        return -1;
+    }
+
+    size_t sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->ringSize = sqRingSize > cqRingSize ? sqRingSize : cqRingSize;
+
+    ring->ringMemory = mmap(NULL, ring->ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            ring->fd, IORING_OFF_SQ_RING);
+    if (ring->ringMemory == MAP_FAILED)
+    {
+        close(ring->fd);
+        return -1;
+    }
+
+    ring->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED)
+    {
+        munmap(ring->ringMemory, ring->ringSize);
+        close(ring->fd);
+        return -1;
+    }
+
+    char *memory = ring->ringMemory;
+    ring->sqHead = (unsigned *)(memory + params.sq_off.head);
+    ring->sqTail = (unsigned *)(memory + params.sq_off.tail);
+    ring->sqMask = *(unsigned *)(memory + params.sq_off.ring_mask);
+    ring->sqEntries = params.sq_entries;
+    ring->sqArray = (unsigned *)(memory + params.sq_off.array);
+    ring->sqeTail = *ring->sqTail;
+
+    ring->cqHead = (unsigned *)(memory + params.cq_off.head);
+    ring->cqTail = (unsigned *)(memory + params.cq_off.tail);
+    ring->cqMask = *(unsigned *)(memory + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(memory + params.cq_off.cqes);
+
+    // Entries are always submitted in the order they are handed out
+    for (unsigned i = 0; i < ring->sqEntries; i++)
+    {
+        ring->sqArray[i] = i;
+    }
+
+    return 0;
+}
+
+struct io_uring_sqe *uring_get_sqe(struct Uring *ring)
+{
+    if (ring->sqeTail - __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE) == ring->sqEntries)
+    {
+        uring_submit(ring);
+
+        // Only consuming completions can make room now, which is up to the caller
+        if (ring->sqeTail - __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE) == ring->sqEntries)
+        {
+            fprintf(stderr, "io_uring submission queue full\n");
+            exit(1);
+        }
+    }
+
+    struct io_uring_sqe *sqe = &ring->sqes[ring->sqeTail & ring->sqMask];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sqeTail++;
+
+    return sqe;
+}
+
+void uring_prep_sendmsg(struct io_uring_sqe *sqe, int fd, const struct msghdr *message, int flags, uint64_t userData)
+{
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)message;
+    sqe->len = 1;
+    sqe->msg_flags = flags;
+    sqe->user_data = userData;
+}
+
+void uring_prep_recv_multishot(struct io_uring_sqe *sqe, int fd, const struct UringBuffers *buffers, uint64_t userData)
+{
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = buffers->groupId;
+    sqe->user_data = userData;
+}
+
+void uring_prep_recvmsg_multishot(struct io_uring_sqe *sqe, int fd, const struct msghdr *message,
+                                  const struct UringBuffers *buffers, uint64_t userData)
+{
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)message;
+    sqe->len = 1;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = buffers->groupId;
+    sqe->user_data = userData;
+}
+
+void uring_prep_write(struct io_uring_sqe *sqe, int fd, const void *buffer, unsigned length,
+                      unsigned long long offset, uint64_t userData)
+{
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)buffer;
+    sqe->len = length;
+    sqe->off = offset;
+    sqe->user_data = userData;
+}
+
+int uring_buffers_init(struct Uring *ring, struct UringBuffers *buffers, uint16_t groupId, unsigned entries,
+                       size_t bufferSize)
+{
+    memset(buffers, 0, sizeof(*buffers));
+    buffers->entries = entries;
+    buffers->groupId = groupId;
+    buffers->bufferSize = bufferSize;
+
+    // The ring must start on a page boundary
+    buffers->ring = mmap(NULL, entries * sizeof(struct io_uring_buf), PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffers->ring == MAP_FAILED)
+    {
+        return -1;
+    }
+
+    buffers->memory = malloc(entries * bufferSize);
+    if (buffers->memory == NULL)
+    {
+        munmap(buffers->ring, entries * sizeof(struct io_uring_buf));
+        return -1;
+    }
+
+    struct io_uring_buf_reg registration;
+    memset(&registration, 0, sizeof(registration));
+    registration.ring_addr = (uint64_t)(uintptr_t)buffers->ring;
+    registration.ring_entries = entries;
+    registration.bgid = groupId;
+
+    if (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PBUF_RING, &registration, 1) < 0)
+    {
+        free(buffers->memory);
+        munmap(buffers->ring, entries * sizeof(struct io_uring_buf));
+        return -1;
+    }
+
+    for (unsigned i = 0; i < entries; i++)
+    {
+        uring_buffer_release(buffers, i);
+    }
+
+    return 0;
+}
+
+char *uring_buffer(const struct UringBuffers *buffers, uint16_t bufferId)
+{
+    return buffers->memory + (size_t)bufferId * buffers->bufferSize;
+}
+
+void uring_buffer_release(struct UringBuffers *buffers, uint16_t bufferId)
+{
+    struct io_uring_buf *buffer = &buffers->ring->bufs[buffers->tail & (buffers->entries - 1)];
+    buffer->addr = (uint64_t)(uintptr_t)uring_buffer(buffers, bufferId);
+    buffer->len = buffers->bufferSize;
+    buffer->bid = bufferId;
+
+    // The buffer must be filled in before the kernel can see the new tail
+    buffers->tail++;
+    __atomic_store_n(&buffers->ring->tail, buffers->tail, __ATOMIC_RELEASE);
+}
+
+void uring_buffers_exit(struct Uring *ring, struct UringBuffers *buffers)
+{
+    struct io_uring_buf_reg registration;
+    memset(&registration, 0, sizeof(registration));
+    registration.bgid = buffers->groupId;
+
+    syscall(__NR_io_uring_register, ring->fd, IORING_UNREGISTER_PBUF_RING, &registration, 1);
+    free(buffers->memory);
+    munmap(buffers->ring, buffers->entries * sizeof(struct io_uring_buf));
+}
+
+void uring_submit(struct Uring *ring)
+{
+    unsigned toSubmit = uring_flush(ring);
+
+    while (toSubmit > 0)
+    {
+        int submitted = uring_enter(ring, toSubmit, 0, 0, NULL);
+        if (submitted < 0)
+        {
+            // EBUSY means the completion queue is full, so there is no room to submit more for now
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+            {
+                return;
+            }
+
+            perror("io_uring_enter");
+            exit(1);
+        }
+
+        toSubmit -= submitted;
+    }
+}
+
+void uring_wait(struct Uring *ring, unsigned long long timeout)
+{
+    unsigned toSubmit = uring_flush(ring);
+
+    if (uring_peek(ring) != NULL && toSubmit == 0)
+    {
+        return;
+    }
+
+    struct __kernel_timespec ts;
+    ts.tv_sec = timeout / 1000000000;
+    ts.tv_nsec = timeout % 1000000000;
+
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    arg.ts = (uint64_t)(uintptr_t)&ts;
+
+    if (uring_enter(ring, toSubmit, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg) < 0 &&
+        errno != ETIME && errno != EINTR && errno != EBUSY)
+    {
+        perror("io_uring_enter");
+        exit(1);
+    }
+}
+
+struct io_uring_cqe *uring_peek(struct Uring *ring)
+{
+    unsigned head = *ring->cqHead;
+
+    // The completion must be read after the kernel's write of the tail that covers it
+    if (head == __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE))
+    {
+        return NULL;
+    }
+
+    return &ring->cqes[head & ring->cqMask];
+}
+
+void uring_advance(struct Uring *ring)
+{
+    __atomic_store_n(ring->cqHead, *ring->cqHead + 1, __ATOMIC_RELEASE);
+}
+
+void uring_exit(struct Uring *ring)
+{
+    munmap(ring->sqes, ring->sqesSize);
+    munmap(ring->ringMemory, ring->ringSize);
+    close(ring->fd);
+}
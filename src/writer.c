@@ -0,0 +1,151 @@
+/** @file writer.c
+ *  @brief The file writer thread of the UDP receiver
+ *
+ *  This contains the writer thread. It takes the slots the receive loop
+ *  hands over through the ring, in order, and writes the data of slots
+ *  that follow on from each other in the file with a single pwritev call.
+ *
+ *  @author Vicky Chen (chen-vv)
+ *  @author Eric Omielan (eomielan)
+ *  @bug No known bugs.
+ */
+
+/* -- Includes -- */
+
+#define _GNU_SOURCE // For pwritev
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "include/writer.h"
+
+/**
+ * @brief Writes all of the data of a run of slots that follow on from each other in the file.
+ *
+ * @param writer The writer
+ * @param data The data of each slot
+ * @param count The number of slots
+ * @param offset The offset in the file the first slot's data belongs at
+ * @return Void
+ */
+void write_run(struct Writer *writer, struct iovec *data, int count, unsigned long long offset)
+{
+    while (count > 0)
+    {
+        ssize_t written = writer->seekable ? pwritev(writer->fd, data, count, offset) : writev(writer->fd, data, count);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            perror("pwritev");
+            exit(1);
+        }
+
+        offset += written;
+
+        // A short write may end partway through a slot's data
+        while (count > 0 && (size_t)written >= data->iov_len)
+        {
+            written -= data->iov_len;
+            data++;
+            count--;
+        }
+        if (count > 0)
+        {
+            data->iov_base = (char *)data->iov_base + written;
+            data->iov_len -= written;
+        }
+    }
+}
+
+/**
+ * @brief The writer thread, which writes the slots handed over until writer_finish.
+ *
+ * @param arg The writer
+ * @return NULL
+ */
+void *writer_run(void *arg)
+{
+    struct Writer *writer = arg;
+    struct iovec data[WRITE_BATCH_SIZE];
+    uint32_t head = 0;
+
+    while (TRUE)
+    {
+        uint32_t tail = ring_wait(&writer->ring, head);
+        if (tail == head)
+        {
+            return NULL;
+        }
+
+        while (head != tail)
+        {
+            // Join the slots whose data follows on from each other in the file
+            struct WriteSlot *first = ring_slot(&writer->ring, head);
+            unsigned long long end = first->offset;
+            int count = 0;
+
+            while (head + count != tail && count < WRITE_BATCH_SIZE)
+            {
+                struct WriteSlot *slot = ring_slot(&writer->ring, head + count);
+                if (slot->offset != end)
+                {
+                    break;
+                }
+
+                data[count].iov_base = slot->data;
+                data[count].iov_len = slot->length;
+                end += slot->length;
+                count++;
+            }
+
+            write_run(writer, data, count, first->offset);
+
+            head += count;
+            ring_release(&writer->ring, head);
+        }
+    }
+}
+
+void writer_start(struct Writer *writer, int fd, int seekable, unsigned entries)
+{
+    writer->fd = fd;
+    writer->seekable = seekable;
+    ring_init(&writer->ring, entries, sizeof(struct WriteSlot));
+
+    int err = pthread_create(&writer->thread, NULL, writer_run, writer);
+    if (err != 0)
+    {
+        fprintf(stderr, "pthread_create: %s\n", strerror(err));
+        exit(1);
+    }
+}
+
+struct WriteSlot *writer_reserve(struct Writer *writer)
+{
+    return ring_reserve(&writer->ring);
+}
+
+void writer_commit(struct Writer *writer)
+{
+    ring_commit(&writer->ring);
+}
+
+unsigned writer_space(struct Writer *writer)
+{
+    return ring_space(&writer->ring);
+}
+
+void writer_finish(struct Writer *writer)
+{
+    ring_close(&writer->ring);
+    pthread_join(writer->thread, NULL);
+    ring_destroy(&writer->ring);
+}